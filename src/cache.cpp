@@ -0,0 +1,254 @@
+/*
+	@copydoc cache.hpp
+*/
+
+#include "cache.hpp"
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	const char MAGIC[8] = { 'I', 'S', 'E', 'G', 'C', 'U', 'T', '\0' };
+	const char* SUFFIX = ".cut";		// Ending of result files
+	const char* TEMPORARY = ".tmp-";	// Start of files still being written
+	const time_t ABANDONED = 3600;		// Seconds after which an unfinished file is taken to be abandoned
+
+	std::atomic<uint64_t> written(0);	// Files this process has started to write, to give each a name of its own
+
+	//! @brief Writes every byte, carrying on after short or interrupted writes
+	//! @retval true if successful, false otherwise
+	bool writeAll(int fd, const void* data, size_t bytes)
+	{
+		const char* pos = static_cast<const char*>(data);
+		while (bytes > 0)
+		{
+			ssize_t count = write(fd, pos, bytes);
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count <= 0)
+				return false;
+			pos   += count;
+			bytes -= count;
+		}
+		return true;
+	}
+
+	//! @brief Final mixing step of MurmurHash3, spreading every input bit over the whole word
+	uint64_t finish(uint64_t word)
+	{
+		word ^= word >> 33;
+		word *= 0xFF51AFD7ED558CCDULL;
+		word ^= word >> 33;
+		word *= 0xC4CEB9FE1A85EC53ULL;
+		word ^= word >> 33;
+		return word;
+	}
+
+	//! @brief A result file found while evicting
+	struct cacheEntry
+	{
+		std::string name;		//! File name
+		off_t size;				//! Bytes
+		struct timespec used;	//! Last modification, which find moves forward on every hit
+
+		bool operator<(const cacheEntry& other) const
+		{
+			return (used.tv_sec != other.used.tv_sec) ? (used.tv_sec < other.used.tv_sec)
+				: (used.tv_nsec < other.used.tv_nsec);
+		}
+	};
+}
+
+ContentHash::ContentHash() : length(0)
+{
+	lanes[0] = 0x243F6A8885A308D3ULL;
+	lanes[1] = 0x13198A2E03707344ULL;
+}
+
+void ContentHash::mix(uint64_t word)
+{
+	lanes[0] = (lanes[0] ^ word) * 0x9E3779B97F4A7C15ULL;
+	lanes[0] ^= lanes[0] >> 32;
+	lanes[1] = (lanes[1] + word) * 0xC2B2AE3D27D4EB4FULL;
+	lanes[1] = (lanes[1] << 31) | (lanes[1] >> 33);
+}
+
+void ContentHash::add(const void* data, size_t bytes)
+{
+	const unsigned char* pos = static_cast<const unsigned char*>(data);
+	length += bytes;
+	for (; bytes >= sizeof(uint64_t); bytes -= sizeof(uint64_t), pos += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, pos, sizeof(word));
+		mix(word);
+	}
+
+	// The number of bytes left over is folded into the last word, so that trailing zeros still count
+	if (bytes > 0)
+	{
+		uint64_t word = 0;
+		memcpy(&word, pos, bytes);
+		mix(word ^ (static_cast<uint64_t>(bytes) << 56));
+	}
+}
+
+void ContentHash::add(int64_t value)
+{
+	add(&value, sizeof(value));
+}
+
+std::string ContentHash::hex() const
+{
+	char digits[33];
+	snprintf(digits, sizeof(digits), "%016llx%016llx",
+		static_cast<unsigned long long>(finish(lanes[0] ^ length)),
+		static_cast<unsigned long long>(finish(lanes[1] + length)));
+	return digits;
+}
+
+ResultCache::ResultCache() : maxBytes(0)
+{
+}
+
+bool ResultCache::open(const char* dir, uint64_t bytes)
+{
+	if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+	{
+		std::cerr << "Could not create cache directory: " << dir << "\n";
+		return false;
+	}
+
+	directory = dir;
+	maxBytes  = bytes;
+	return true;
+}
+
+std::string ResultCache::path(const std::string& key) const
+{
+	return directory + "/" + key + SUFFIX;
+}
+
+bool ResultCache::find(const std::string& key, int width, int height, std::vector<bool>& foreground,
+	int64_t& maxFlow)
+{
+	std::string file = path(key);
+	std::ifstream input(file.c_str(), std::ios::binary);
+	if (!input)
+		return false;
+
+	header h;
+	input.read(reinterpret_cast<char*>(&h), sizeof(h));
+	if (!input || memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.version != VERSION || h.width != width
+		|| h.height != height)
+		return false;
+
+	size_t pixels = static_cast<size_t>(width) * height;
+	std::vector<unsigned char> packed((pixels + 7) / 8);
+	input.read(reinterpret_cast<char*>(&packed[0]), packed.size());
+	if (!input)
+		return false;
+
+	foreground.resize(pixels);
+	for (size_t i = 0; i < pixels; ++i)
+		foreground[i] = (packed[i / 8] >> (i % 8)) & 1;
+	maxFlow = h.maxFlow;
+
+	// Mark the result as recently used
+	utimensat(AT_FDCWD, file.c_str(), NULL, 0);
+	return true;
+}
+
+bool ResultCache::store(const std::string& key, int width, int height, const std::vector<bool>& foreground,
+	int64_t maxFlow)
+{
+	size_t pixels = static_cast<size_t>(width) * height;
+	std::vector<unsigned char> packed((pixels + 7) / 8, 0);
+	for (size_t i = 0; i < pixels; ++i)
+		if (foreground[i])
+			packed[i / 8] |= 1 << (i % 8);
+
+	header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, MAGIC, sizeof(MAGIC));
+	h.version = VERSION;
+	h.width   = width;
+	h.height  = height;
+	h.maxFlow = maxFlow;
+
+	// Write under a name no other process or thread uses, then rename over the result in one step. The data reaches
+	// the disk before the rename, so a crash cannot leave the result's name on a partial file.
+	std::stringstream temporary;
+	temporary << directory << "/" << TEMPORARY << getpid() << "-" << written++ << "-" << key;
+	std::string temporaryFile = temporary.str();
+	int fd = ::open(temporaryFile.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+	if (fd < 0)
+	{
+		std::cerr << "Could not open file: " << temporaryFile << "\n";
+		return false;
+	}
+	bool complete = writeAll(fd, &h, sizeof(h)) && (packed.empty() || writeAll(fd, &packed[0], packed.size()))
+		&& fsync(fd) == 0;
+	complete = (close(fd) == 0) && complete;
+	if (!complete || rename(temporaryFile.c_str(), path(key).c_str()) != 0)
+	{
+		std::cerr << "Could not write cache file: " << path(key) << "\n";
+		unlink(temporaryFile.c_str());
+		return false;
+	}
+
+	evict();
+	return true;
+}
+
+void ResultCache::evict()
+{
+	DIR* listing = opendir(directory.c_str());
+	if (!listing)
+		return;
+
+	std::vector<cacheEntry> entries;
+	uint64_t total = 0;
+	time_t now = time(NULL);
+	size_t suffixLength = strlen(SUFFIX);
+	for (struct dirent* item = readdir(listing); item; item = readdir(listing))
+	{
+		std::string name = item->d_name;
+		std::string file = directory + "/" + name;
+		struct stat info;
+		if (stat(file.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+			continue;
+
+		if (name.compare(0, strlen(TEMPORARY), TEMPORARY) == 0)
+		{
+			if (now - info.st_mtime > ABANDONED)
+				unlink(file.c_str());
+		}
+		else if (name.size() > suffixLength && name.compare(name.size() - suffixLength, suffixLength, SUFFIX) == 0)
+		{
+			cacheEntry entry = { name, info.st_size, info.st_mtim };
+			entries.push_back(entry);
+			total += info.st_size;
+		}
+	}
+	closedir(listing);
+
+	// Another process may be evicting too; removing a file that is already gone does no harm
+	std::sort(entries.begin(), entries.end());
+	for (size_t i = 0; i < entries.size() && total > maxBytes; ++i)
+	{
+		unlink((directory + "/" + entries[i].name).c_str());
+		total -= entries[i].size;
+	}
+}
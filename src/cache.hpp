@@ -0,0 +1,100 @@
+/*
+	@brief On-disk cache of segmentation results, keyed by the content of the image and the settings that decide
+	 its cut.
+	@author Drew Guarnera, Bharath Bogadamidi, Heather Michaud
+	@version 0.9
+	@copyright Copyright 2014 Guarnera, Bogadamidi, Michaud. All rights reserved.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+//! @brief 128 bit hash of a sequence of values, fast enough to run over every pixel of an image. Not cryptographic.
+class ContentHash
+{
+public:
+	//! @brief Basic constructor
+	ContentHash();
+
+	//! @brief Adds bytes to the hash
+	//! @param data First byte
+	//! @param bytes Number of bytes
+	void add(const void* data, size_t bytes);
+
+	//! @brief Adds one value to the hash
+	void add(int64_t value);
+
+	//! @brief Gets the hash of everything added so far
+	//! @retval 32 hexadecimal digits
+	std::string hex() const;
+
+private:
+	//! @brief Mixes one word into both lanes
+	void mix(uint64_t word);
+
+	uint64_t lanes[2];	// Independent halves of the hash
+	uint64_t length;	// Bytes added
+};
+
+//! @brief Directory of segmentation results that several processes can share. Each result is one file holding the
+//!	 image size, the maximum flow and the foreground packed eight pixels to a byte. Files are written under a
+//!	 temporary name and renamed into place, so a reader never sees a partial result. Reading a result marks it as
+//!	 recently used; once the directory grows past its size limit, the least recently used results are removed.
+class ResultCache
+{
+public:
+	//! @brief Basic constructor
+	ResultCache();
+
+	//! @brief Opens a cache directory, creating it if needed
+	//! @param directory The directory
+	//! @param maxBytes Most bytes of results to keep
+	//! @retval true if successful, false otherwise
+	bool open(const char* directory, uint64_t maxBytes);
+
+	//! @brief Looks up a result
+	//! @param key Hash of the image and settings, from ContentHash::hex
+	//! @param width Width of the image, checked against the result
+	//! @param height Height of the image, checked against the result
+	//! @param foreground Filled with true for every foreground pixel, in raster order
+	//! @param maxFlow Set to the maximum flow
+	//! @retval true if the result was found
+	bool find(const std::string& key, int width, int height, std::vector<bool>& foreground, int64_t& maxFlow);
+
+	//! @brief Adds a result, then removes the least recently used results while the cache is over its size limit
+	//! @param key Hash of the image and settings, from ContentHash::hex
+	//! @param width Width of the image
+	//! @param height Height of the image
+	//! @param foreground True for every foreground pixel, in raster order
+	//! @param maxFlow The maximum flow
+	//! @retval true if successful, false otherwise
+	bool store(const std::string& key, int width, int height, const std::vector<bool>& foreground, int64_t maxFlow);
+
+	//! @brief Layout of the start of every result file
+	struct header
+	{
+		char magic[8];		//! "ISEGCUT"
+		uint32_t version;	//! VERSION
+		int32_t width;		//! Image width
+		int32_t height;		//! Image height
+		int32_t reserved;	//! Zero
+		int64_t maxFlow;	//! Maximum flow
+	};
+
+	static const uint32_t VERSION = 1;	//!< Version of the result file layout
+
+private:
+	//! @brief Removes the least recently used results until the cache fits its size limit, along with temporary
+	//!	 files left behind by writers that did not finish
+	void evict();
+
+	//! @brief Gets the path of a result
+	std::string path(const std::string& key) const;
+
+	std::string directory;	// Cache directory
+	uint64_t maxBytes;		// Most bytes of results to keep
+};
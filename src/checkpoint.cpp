@@ -0,0 +1,101 @@
+/*
+	@copydoc checkpoint.hpp
+*/
+
+#include "checkpoint.hpp"
+#include "cache.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace CheckpointFile
+{
+	const char MAGIC[8] = { 'I', 'S', 'E', 'G', 'C', 'K', 'P', '\0' };
+
+	std::string fingerprint(const void* first, size_t firstBytes, const void* head, size_t headBytes,
+		const void* base, size_t baseBytes, int64_t source, int64_t sink)
+	{
+		ContentHash hash;
+		hash.add(source);
+		hash.add(sink);
+		hash.add(first, firstBytes);
+		hash.add(head, headBytes);
+		hash.add(base, baseBytes);
+		return hash.hex();
+	}
+
+	bool writeAt(int fd, const void* data, size_t bytes, uint64_t offset)
+	{
+		const char* pos = static_cast<const char*>(data);
+		while (bytes > 0)
+		{
+			ssize_t written = pwrite(fd, pos, bytes, offset);
+			if (written < 0 && errno == EINTR)
+				continue;
+			if (written <= 0)
+				return false;
+			pos    += written;
+			bytes  -= written;
+			offset += written;
+		}
+		return true;
+	}
+
+	bool readAt(int fd, void* data, size_t bytes, uint64_t offset)
+	{
+		char* pos = static_cast<char*>(data);
+		while (bytes > 0)
+		{
+			ssize_t read = pread(fd, pos, bytes, offset);
+			if (read < 0 && errno == EINTR)
+				continue;
+			if (read <= 0)
+				return false;
+			pos    += read;
+			bytes  -= read;
+			offset += read;
+		}
+		return true;
+	}
+
+	bool writeSlot(int fd, int index, uint64_t sequence, uint64_t flow)
+	{
+		slot s;
+		s.sequence = sequence;
+		s.flow     = flow;
+		s.check    = (sequence == 0) ? 0 : (sequence ^ flow ^ CHECK);
+		return writeAt(fd, &s, sizeof(s), SLOTS_AT + (index * sizeof(s))) && sync(fd);
+	}
+
+	bool readSlot(int fd, int index, slot& s)
+	{
+		return readAt(fd, &s, sizeof(s), SLOTS_AT + (index * sizeof(s))) && s.sequence != 0
+			&& s.check == (s.sequence ^ s.flow ^ CHECK);
+	}
+
+	int open(const char* file, bool create)
+	{
+		int fd = ::open(file, create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0666);
+		if (fd < 0)
+			std::cerr << "Could not open file: " << file << "\n";
+		return fd;
+	}
+
+	uint64_t length(int fd)
+	{
+		struct stat info;
+		return (fstat(fd, &info) == 0) ? static_cast<uint64_t>(info.st_size) : 0;
+	}
+
+	bool sync(int fd)
+	{
+		return fdatasync(fd) == 0;
+	}
+
+	void close(int fd)
+	{
+		if (fd >= 0)
+			::close(fd);
+	}
+}
@@ -0,0 +1,432 @@
+/*
+	@brief Periodic snapshots of a max-flow solve, written in the background, from which an interrupted solve can be
+	 resumed.
+	@author Drew Guarnera, Bharath Bogadamidi, Heather Michaud
+	@version 0.9
+	@copyright Copyright 2014 Guarnera, Bogadamidi, Michaud. All rights reserved.
+*/
+
+#pragma once
+
+#include "network.hpp"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! @brief Layout of checkpoint files, and the file operations shared by every FlowCheckpoint instantiation
+namespace CheckpointFile
+{
+	extern const char MAGIC[8];		//!< First bytes of a checkpoint file
+	const uint32_t VERSION = 1;		//!< Checkpoint format version
+	const size_t SLOTS_AT = 512;	//!< Offset of the two slot headers
+	const size_t DATA_AT = 4096;	//!< Offset of the residual capacities of the first slot; the second follows it
+
+	//! @brief Fixed size header at the start of a checkpoint file
+	struct header
+	{
+		char magic[8];				//! Always MAGIC
+		uint32_t version;			//! Format version, VERSION
+		uint32_t capacityBytes;		//! Size of one capacity value
+		uint32_t indexBytes;		//! Size of one vertex or arc index
+		uint32_t reserved;			//! Zero
+		int64_t arcs;				//! Number of arcs, including reverse arcs
+		char fingerprint[32];		//! Hash of the network's arcs, base capacities, source and sink
+	};
+
+	//! @brief Header of one of the two snapshots held in the file. A slot is cleared before its capacities are
+	//!	 rewritten and only filled in again once they are on disk, so a slot that reads as valid is always complete.
+	struct slot
+	{
+		uint64_t sequence;	//! Number of the snapshot, higher for later ones; 0 for an empty slot
+		uint64_t flow;		//! Bits of the flow value, an int64_t or a double
+		uint64_t check;		//! sequence ^ flow ^ CHECK, to tell a complete header from a torn one
+	};
+
+	const uint64_t CHECK = 0x5F3759DF9E3779B9ULL;	//!< Mixed into slot::check
+
+	//! @brief Gets the hash identifying a network, from its arrays
+	//! @retval 32 hexadecimal digits
+	std::string fingerprint(const void* first, size_t firstBytes, const void* head, size_t headBytes,
+		const void* base, size_t baseBytes, int64_t source, int64_t sink);
+
+	//! @brief Writes a whole buffer at an offset, retrying short writes
+	//! @retval true if successful, false otherwise
+	bool writeAt(int fd, const void* data, size_t bytes, uint64_t offset);
+
+	//! @brief Reads a whole buffer from an offset
+	//! @retval true if successful, false otherwise
+	bool readAt(int fd, void* data, size_t bytes, uint64_t offset);
+
+	//! @brief Writes a slot header and waits until it is on disk
+	//! @retval true if successful, false otherwise
+	bool writeSlot(int fd, int index, uint64_t sequence, uint64_t flow);
+
+	//! @brief Reads a slot header
+	//! @retval true if the slot holds a complete snapshot
+	bool readSlot(int fd, int index, slot& s);
+
+	//! @brief Opens a checkpoint file for reading and writing
+	//! @param create Truncate or create the file rather than open an existing one
+	//! @retval The file descriptor, or -1 if it could not be opened
+	int open(const char* file, bool create);
+
+	//! @brief Gets the size of a file
+	//! @retval Bytes, or 0 if the size could not be read
+	uint64_t length(int fd);
+
+	//! @brief Waits until everything written to a file is on disk
+	//! @retval true if successful, false otherwise
+	bool sync(int fd);
+
+	//! @brief Closes a file opened by open
+	void close(int fd);
+}
+
+namespace Tools
+{
+	//! @brief Snapshots of the residual capacities and flow of a FlowNetwork while fordFulkerson solves it. The file
+	//!	 holds two snapshots, written in turn, so the older one survives if the process dies during a write. Only
+	//!	 the blocks of arcs changed since a slot was last written are copied, and the copy is written to disk by a
+	//!	 thread of its own; the solver only waits for the copy of the changed blocks.
+	template<typename Cap, typename Index>
+	class FlowCheckpoint
+	{
+	public:
+		static const size_t BLOCK = 4096;	//!< Arcs per block tracked for changes
+
+		//! @brief Basic constructor
+		FlowCheckpoint() : fd(-1), interval(0), target(0), sequence(0), arcs(0), busy(false), pending(false),
+			stopping(false), failed(false), jobSlot(0), jobSequence(0), jobFlow(0) {}
+
+		//! @brief Finishes the snapshot being written, if any, and closes the file
+		~FlowCheckpoint()
+		{
+			stop();
+			CheckpointFile::close(fd);
+		}
+
+		//! @brief Starts a new checkpoint file, holding the network's current state in both slots
+		//! @param file Path to the checkpoint file, replaced if it exists
+		//! @param g The network, before solving starts
+		//! @param flow The flow already in the network's residual capacities
+		//! @param milliseconds Time between snapshots
+		//! @retval true if successful, false otherwise
+		template<typename Total>
+		bool create(const char* file, const FlowNetwork<Cap, Index>& g, Total flow, long milliseconds)
+		{
+			stop();
+			CheckpointFile::close(fd);
+			sequence = 0;
+			fd = CheckpointFile::open(file, true);
+			if (fd < 0)
+				return false;
+			name = file;
+
+			CheckpointFile::header h;
+			memset(&h, 0, sizeof(h));
+			memcpy(h.magic, CheckpointFile::MAGIC, sizeof(h.magic));
+			h.version       = CheckpointFile::VERSION;
+			h.capacityBytes = sizeof(Cap);
+			h.indexBytes    = sizeof(Index);
+			h.arcs          = g.arcs();
+			memcpy(h.fingerprint, fingerprint(g).c_str(), sizeof(h.fingerprint));
+			if (!CheckpointFile::writeAt(fd, &h, sizeof(h), 0))
+			{
+				std::cerr << "Could not write checkpoint file: " << file << "\n";
+				return reject();
+			}
+			arcs = g.arcs();
+			return begin(g.cap, bits(flow), milliseconds, 0) || reject();
+		}
+
+		//! @brief Restores a network from the latest snapshot in a checkpoint file, which is then written to from
+		//!	 there on. The network is left unchanged unless the snapshot is restored.
+		//! @param file Path to the checkpoint file
+		//! @param g The network the file was created for. Its residual capacities are replaced.
+		//! @param flow Set to the flow of the snapshot
+		//! @param milliseconds Time between snapshots
+		//! @retval true if successful, false if the file is missing, short, holds no complete snapshot or belongs to
+		//!	 another network
+		template<typename Total>
+		bool resume(const char* file, FlowNetwork<Cap, Index>& g, Total& flow, long milliseconds)
+		{
+			stop();
+			CheckpointFile::close(fd);
+			fd = CheckpointFile::open(file, false);
+			if (fd < 0)
+				return false;
+			name = file;
+			arcs = g.arcs();
+
+			CheckpointFile::header h;
+			if (!CheckpointFile::readAt(fd, &h, sizeof(h), 0) || memcmp(h.magic, CheckpointFile::MAGIC, 8) != 0
+				|| h.version != CheckpointFile::VERSION)
+			{
+				std::cerr << "Not a checkpoint file: " << file << "\n";
+				return reject();
+			}
+			if (h.capacityBytes != sizeof(Cap) || h.indexBytes != sizeof(Index)
+				|| h.arcs != static_cast<int64_t>(g.arcs())
+				|| memcmp(h.fingerprint, fingerprint(g).c_str(), sizeof(h.fingerprint)) != 0)
+			{
+				std::cerr << "Checkpoint file does not belong to this network: " << file << "\n";
+				return reject();
+			}
+			if (CheckpointFile::length(fd) < dataAt(2))
+			{
+				std::cerr << "Checkpoint file is incomplete: " << file << "\n";
+				return reject();
+			}
+
+			// The later of the two complete snapshots wins
+			CheckpointFile::slot slots[2];
+			bool valid[2] = { CheckpointFile::readSlot(fd, 0, slots[0]), CheckpointFile::readSlot(fd, 1, slots[1]) };
+			if (!valid[0] && !valid[1])
+			{
+				std::cerr << "No complete snapshot in checkpoint file: " << file << "\n";
+				return reject();
+			}
+			int latest = (valid[0] && (!valid[1] || slots[0].sequence > slots[1].sequence)) ? 0 : 1;
+
+			// Read into a buffer of its own, so the network only changes once everything has succeeded
+			std::vector<Cap> restored(g.arcs());
+			if (g.arcs() > 0 && !CheckpointFile::readAt(fd, &restored[0], bytes(g.arcs()), dataAt(latest)))
+			{
+				std::cerr << "Could not read checkpoint file: " << file << "\n";
+				return reject();
+			}
+			sequence = slots[latest].sequence;
+			if (!begin(restored.empty() ? NULL : &restored[0], slots[latest].flow, milliseconds, latest))
+				return reject();
+
+			std::copy(restored.begin(), restored.end(), g.cap);
+			memcpy(&flow, &slots[latest].flow, sizeof(flow));
+			return true;
+		}
+
+		//! @brief Records that an arc's residual capacity changed
+		void touch(Index arc)
+		{
+			dirty[static_cast<size_t>(arc) / BLOCK] = 3;
+		}
+
+		//! @brief Checks whether a snapshot is due
+		bool due() const
+		{
+			return std::chrono::steady_clock::now() >= next;
+		}
+
+		//! @brief Takes a snapshot and hands it to the writer thread. If the writer is still busy with the last
+		//!	 snapshot, nothing is taken and the next call tries again.
+		//! @param g The network
+		//! @param flow The flow in the network's residual capacities
+		template<typename Total>
+		void save(const FlowNetwork<Cap, Index>& g, Total flow)
+		{
+			if (busy.load() || failed)
+				return;
+
+			// Copy the blocks changed since the target slot was written; the slot's other blocks already hold them
+			jobBlocks.clear();
+			jobData.clear();
+			unsigned char mask = static_cast<unsigned char>(1 << target);
+			for (size_t b = 0; b < dirty.size(); ++b)
+			{
+				if (!(dirty[b] & mask))
+					continue;
+				dirty[b] &= ~mask;
+				Index from = static_cast<Index>(b * BLOCK);
+				Index to   = std::min(static_cast<Index>(from + BLOCK), g.arcs());
+				jobBlocks.push_back(b);
+				jobData.insert(jobData.end(), g.cap + from, g.cap + to);
+			}
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobSlot     = target;
+				jobSequence = ++sequence;
+				jobFlow     = bits(flow);
+				pending     = true;
+				busy.store(true);
+			}
+			wake.notify_all();
+			target ^= 1;
+			next = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval);
+		}
+
+		//! @brief Writes the final state and waits until it is on disk
+		//! @param g The network
+		//! @param flow The flow in the network's residual capacities
+		//! @retval true if every snapshot was written, false otherwise
+		template<typename Total>
+		bool finish(const FlowNetwork<Cap, Index>& g, Total flow)
+		{
+			wait();
+			save(g, flow);
+			wait();
+			if (failed)
+				std::cerr << "Could not write checkpoint file: " << name << "\n";
+			return !failed;
+		}
+
+	private:
+		//! @brief Makes both slots hold the given capacities, then starts the writer thread
+		//! @param data Residual capacity of every arc
+		//! @param flow Bits of the flow in those capacities
+		//! @param milliseconds Time between snapshots
+		//! @param written Slot that already holds them, if sequence is above 0
+		bool begin(const Cap* data, uint64_t flow, long milliseconds, int written)
+		{
+			interval = milliseconds;
+			dirty.assign((static_cast<size_t>(arcs) + BLOCK - 1) / BLOCK, 0);
+
+			// A new file has neither slot written; a resumed one has its latest
+			for (int s = 0; s < 2; ++s)
+			{
+				if (s == written && sequence > 0)
+					continue;
+				if (!CheckpointFile::writeSlot(fd, s, 0, 0)
+					|| (arcs > 0 && !CheckpointFile::writeAt(fd, data, bytes(arcs), dataAt(s)))
+					|| !CheckpointFile::sync(fd) || !CheckpointFile::writeSlot(fd, s, ++sequence, flow))
+				{
+					std::cerr << "Could not write checkpoint file: " << name << "\n";
+					return false;
+				}
+			}
+
+			target = 0;
+			next = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval);
+			writer = std::thread(&FlowCheckpoint::write, this);
+			return true;
+		}
+
+		//! @brief Stops the writer thread once it has written the snapshot it holds, if any
+		void stop()
+		{
+			if (!writer.joinable())
+				return;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			writer.join();
+			stopping = false;
+		}
+
+		//! @brief Closes the file after a failed create or resume
+		//! @retval false
+		bool reject()
+		{
+			CheckpointFile::close(fd);
+			fd = -1;
+			sequence = 0;
+			return false;
+		}
+
+		//! @brief Writer thread: writes each snapshot handed over by save
+		void write()
+		{
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					while (!pending && !stopping)
+						wake.wait(lock);
+					if (!pending)
+						return;
+					pending = false;
+				}
+
+				// Clear the slot, write the changed blocks, then fill the slot in once they are on disk
+				bool ok = CheckpointFile::writeSlot(fd, jobSlot, 0, 0);
+				size_t offset = 0;
+				for (size_t i = 0; ok && i < jobBlocks.size(); ++i)
+				{
+					size_t count = std::min(BLOCK, jobData.size() - offset);
+					ok = CheckpointFile::writeAt(fd, &jobData[offset], bytes(count),
+						dataAt(jobSlot) + bytes(jobBlocks[i] * BLOCK));
+					offset += count;
+				}
+				ok = ok && CheckpointFile::sync(fd) && CheckpointFile::writeSlot(fd, jobSlot, jobSequence, jobFlow);
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					failed = failed || !ok;
+					busy.store(false);
+				}
+				wake.notify_all();
+			}
+		}
+
+		//! @brief Waits until the writer thread is idle
+		void wait()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (busy.load())
+				wake.wait(lock);
+		}
+
+		//! @brief Gets the hash identifying a network
+		static std::string fingerprint(const FlowNetwork<Cap, Index>& g)
+		{
+			return CheckpointFile::fingerprint(g.first, (static_cast<size_t>(g.nodes()) + 1) * sizeof(Index), g.head,
+				static_cast<size_t>(g.arcs()) * sizeof(Index), g.base, bytes(g.arcs()), g.source, g.sink);
+		}
+
+		//! @brief Gets the bits of a flow value
+		template<typename Total>
+		static uint64_t bits(Total flow)
+		{
+			uint64_t value = 0;
+			memcpy(&value, &flow, std::min(sizeof(flow), sizeof(value)));
+			return value;
+		}
+
+		//! @brief Gets the size of a number of capacities
+		static uint64_t bytes(uint64_t count)
+		{
+			return count * sizeof(Cap);
+		}
+
+		//! @brief Gets the offset of the capacities of a slot
+		uint64_t dataAt(int s) const
+		{
+			return CheckpointFile::DATA_AT + (s * bytes(arcs));
+		}
+
+		int fd;							// Checkpoint file
+		std::string name;				// Path to the checkpoint file, for error messages
+		long interval;					// Milliseconds between snapshots
+		std::chrono::steady_clock::time_point next;	// When the next snapshot is due
+		std::vector<unsigned char> dirty;	// For each block, bit s set if it changed since slot s was written
+		int target;						// Slot the next snapshot goes to
+		uint64_t sequence;				// Number of the last snapshot
+		uint64_t arcs;					// Arcs in the network
+
+		std::thread writer;				// Writes snapshots to disk
+		std::mutex mutex;				// Guards the fields below
+		std::condition_variable wake;	// Signalled when a snapshot is handed over or written
+		std::atomic<bool> busy;			// True from handing a snapshot over until it is on disk
+		bool pending;					// A snapshot waits for the writer
+		bool stopping;					// The writer should stop once idle
+		bool failed;					// A snapshot could not be written
+		int jobSlot;					// Slot of the snapshot being written
+		uint64_t jobSequence;			// Number of the snapshot being written
+		uint64_t jobFlow;				// Flow of the snapshot being written
+		std::vector<size_t> jobBlocks;	// Blocks of the snapshot being written
+		std::vector<Cap> jobData;		// Capacities of those blocks, one after another
+
+		FlowCheckpoint(const FlowCheckpoint&);
+		FlowCheckpoint& operator=(const FlowCheckpoint&);
+	};
+}
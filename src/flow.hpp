@@ -0,0 +1,670 @@
+/*
+	@brief Breadth first search, Ford-Fulkerson, minimum cuts and cut trees on a FlowNetwork, for any capacity and
+	 index type.
+	@author Drew Guarnera, Bharath Bogadamidi, Heather Michaud
+	@version 0.9
+	@copyright Copyright 2014 Guarnera, Bogadamidi, Michaud. All rights reserved.
+*/
+
+#pragma once
+
+#include "network.hpp"
+#include "checkpoint.hpp"
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace Tools
+{
+	//! @brief Point in time at which a solver gives up and returns the flow found so far
+	typedef std::chrono::steady_clock::time_point Deadline;
+
+	//! @brief Type used to add up the flow of a network. Integer capacities are totalled in 64 bits so that the sum of
+	//!	 many narrow capacities cannot overflow.
+	template<typename Cap> struct FlowTotal { typedef int64_t type; };
+	template<> struct FlowTotal<float> { typedef double type; };
+	template<> struct FlowTotal<double> { typedef double type; };
+
+	//! @brief Scratch buffers for the searches of the solvers below. Passing the same workspace to every call saves
+	//!	 allocating them for each network; they only ever grow.
+	template<typename Index>
+	struct FlowWorkspace
+	{
+		std::vector<Index> parentArc;	//! Arc used to reach each node
+		std::vector<int> visited;		//! Epoch of the search that last visited each node
+		std::vector<Index> queue;		//! Nodes still to visit
+		std::vector<bool> marks;		//! Nodes found by the second search of boundingCut
+		int epoch;						//! Epoch of the last search. Earlier epochs left in visited are never reused.
+
+		FlowWorkspace() : epoch(0) {}
+
+		//! @brief Makes room for a network's nodes
+		//! @param nodes Number of nodes in the network
+		void prepare(Index nodes)
+		{
+			size_t size = static_cast<size_t>(nodes);
+			if (parentArc.size() < size)
+				parentArc.resize(size);
+			if (visited.size() < size)
+				visited.resize(size, 0);
+			queue.reserve(size);
+
+			// Start counting again long before the epoch could overflow
+			if (epoch > std::numeric_limits<int>::max() / 2)
+			{
+				std::fill(visited.begin(), visited.end(), 0);
+				epoch = 0;
+			}
+		}
+	};
+
+	//! @brief Breadth first search over arcs with residual capacity. Visits are stamped with an epoch so the buffers
+	//!	 can be reused across searches without clearing them.
+	//! @param g The residual network
+	//! @param start Starting node
+	//! @param end Ending node. The search stops once it is reached.
+	//! @param parentArc Filled with the arc used to reach each visited node
+	//! @param visited Epoch of the search that last visited each node
+	//! @param epoch Epoch of this search
+	//! @param queue Scratch space for the nodes still to visit
+	//! @retval true if the end node was reached
+	template<typename Cap, typename Index>
+	bool residualSearch(const FlowNetwork<Cap, Index>& g, Index start, Index end, std::vector<Index>& parentArc,
+		std::vector<int>& visited, int epoch, std::vector<Index>& queue)
+	{
+		queue.clear();
+		queue.push_back(start);
+		visited[start] = epoch;
+		parentArc[start] = -1;
+
+		for (size_t next = 0; next < queue.size(); ++next)
+		{
+			Index currentNode = queue[next];
+			for (Index a = g.first[currentNode]; a < g.first[currentNode + 1]; ++a)
+			{
+				Index neighbor = g.head[a];
+				if (g.cap[a] > 0 && visited[neighbor] != epoch)
+				{
+					visited[neighbor] = epoch;
+					parentArc[neighbor] = a;
+					if (neighbor == end)
+						return true;
+					queue.push_back(neighbor);
+				}
+			}
+		}
+		return false;
+	}
+
+	//! @brief Performs a breadth first search on the residual network, following arcs with remaining capacity
+	//! @param g The network to perform the breadth first search on
+	//! @param start Starting node
+	//! @param end Ending node. The search will be stopped once this is reached
+	//! @retval The same as breadthFirstSearch on a Graph
+	template<typename Cap, typename Index>
+	std::pair< std::vector<Index>, Cap> breadthFirstSearch(const FlowNetwork<Cap, Index>& g,
+		typename FlowNetwork<Cap, Index>::index_type start, typename FlowNetwork<Cap, Index>::index_type end)
+	{
+		static Cap infinity = std::numeric_limits<Cap>::max();
+		std::vector<Index> shortestPath;
+		Cap minCapacity = infinity;
+		Index numNodes = g.nodes();
+
+		// Start and end node are the same? Capacity is zero and shortest path is itself.
+		if (start == end)
+		{
+			shortestPath.push_back(start);
+			return std::make_pair(shortestPath, Cap(0));
+		}
+
+		// Verify valid start and end is given
+		if ((start < 0) || (start >= numNodes) || (end < 0) || (end >= numNodes))
+			return std::make_pair(shortestPath, minCapacity);
+
+		std::vector<Index> parentArc(numNodes);
+		std::vector<int> visited(numNodes, 0);
+		std::vector<Index> queue;
+		if (!residualSearch(g, start, end, parentArc, visited, 1, queue))
+			return std::make_pair(shortestPath, minCapacity);
+
+		// Back-track from the end node along the arcs that reached each node
+		for (Index currentNode = end; currentNode != start; currentNode = g.head[g.rev[parentArc[currentNode]]])
+		{
+			shortestPath.push_back(currentNode);
+			minCapacity = std::min(minCapacity, g.cap[parentArc[currentNode]]);
+		}
+		shortestPath.push_back(start);
+		std::reverse(shortestPath.begin(), shortestPath.end());
+		return std::make_pair(shortestPath, minCapacity);
+	}
+
+	//! @brief Shortest paths from one start node to many others, as found by searchTree
+	template<typename Cap, typename Index>
+	struct SearchTree
+	{
+		Index start;					//! Node the paths start from
+		std::vector<Index> parent;		//! Node before each reached node on its path, or -1 if not reached
+		std::vector<Index> distance;	//! Arcs on the path to each reached node, or -1 if not reached
+		std::vector<Cap> bottleneck;	//! Smallest residual capacity on the path to each reached node
+
+		//! @brief Checks whether the search reached a node
+		bool reached(Index v) const
+		{
+			return distance[v] >= 0;
+		}
+
+		//! @brief Gets the path to a reached node
+		//! @param v The node
+		//! @param path Filled with the nodes from the start to v
+		void path(Index v, std::vector<Index>& path) const
+		{
+			path.clear();
+			for (; v != start; v = parent[v])
+				path.push_back(v);
+			path.push_back(start);
+			std::reverse(path.begin(), path.end());
+		}
+	};
+
+	//! @brief Breadth first search from one start node to many end nodes at once, following arcs with residual
+	//!	 capacity. The arcs are visited in the same order as breadthFirstSearch, so each path is the one it would find
+	//!	 for that end node alone. The search stops once every end node has been reached.
+	//! @param g The residual network
+	//! @param start Starting node
+	//! @param ends Nodes to find paths to, or empty to find paths to every node
+	//! @param tree Filled with the paths
+	//! @retval false if the start node is not in the network
+	template<typename Cap, typename Index>
+	bool searchTree(const FlowNetwork<Cap, Index>& g, typename FlowNetwork<Cap, Index>::index_type start,
+		const std::vector<Index>& ends, SearchTree<Cap, Index>& tree)
+	{
+		Index numNodes = g.nodes();
+		tree.start = start;
+		tree.parent.assign(numNodes, -1);
+		tree.distance.assign(numNodes, -1);
+		tree.bottleneck.assign(numNodes, 0);
+		if ((start < 0) || (start >= numNodes))
+			return false;
+
+		// Count the distinct end nodes still to reach; without any, the search runs until it has reached everything
+		std::vector<bool> wanted(ends.empty() ? 0 : numNodes, false);
+		size_t remaining = ends.empty() ? static_cast<size_t>(numNodes) : 0;
+		for (size_t i = 0; i < ends.size(); ++i)
+		{
+			if ((ends[i] >= 0) && (ends[i] < numNodes) && !wanted[ends[i]])
+			{
+				wanted[ends[i]] = true;
+				++remaining;
+			}
+		}
+
+		std::vector<Index> queue(1, start);
+		tree.distance[start]   = 0;
+		tree.bottleneck[start] = std::numeric_limits<Cap>::max();
+		if (ends.empty() || wanted[start])
+			--remaining;
+		for (size_t next = 0; next < queue.size() && remaining > 0; ++next)
+		{
+			Index currentNode = queue[next];
+			for (Index a = g.first[currentNode]; a < g.first[currentNode + 1] && remaining > 0; ++a)
+			{
+				Index neighbor = g.head[a];
+				if (g.cap[a] > 0 && tree.distance[neighbor] < 0)
+				{
+					tree.parent[neighbor]     = currentNode;
+					tree.distance[neighbor]   = tree.distance[currentNode] + 1;
+					tree.bottleneck[neighbor] = std::min(tree.bottleneck[currentNode], g.cap[a]);
+					if (ends.empty() || wanted[neighbor])
+						--remaining;
+					queue.push_back(neighbor);
+				}
+			}
+		}
+		return true;
+	}
+
+	//! @brief Pushes flow along short paths from the source to the sink before fordFulkerson runs. First every path
+	//!	 source -> v -> sink is saturated in one sweep over the arcs of the source. Then, if a search limit is given,
+	//!	 each node v that still has capacity from the source sends it along the shortest residual paths found by a
+	//!	 breadth first search from v that gives up after visiting searchLimit nodes.
+	//! @note The work is linear in the number of arcs of the source, times searchLimit. Paths that stay near their
+	//!	 first node, which is most of them in an image, are found without searching the whole network from the
+	//!	 source; fordFulkerson then only has to find the long ones.
+	//! @param g The residual network. The flow pushed is taken from its residual capacities in place.
+	//! @param source
+	//! @param sink
+	//! @param searchLimit Most nodes each local search may visit, or 0 to push along direct paths only
+	//! @param deadline If given, stop searching once this time has passed. The flow already pushed is kept.
+	//! @param workspace Search buffers, kept by the caller across calls
+	//! @retval The flow pushed
+	template<typename Cap, typename Index>
+	typename FlowTotal<Cap>::type greedyFlow(FlowNetwork<Cap, Index>& g,
+		typename FlowNetwork<Cap, Index>::index_type source, typename FlowNetwork<Cap, Index>::index_type sink,
+		typename FlowNetwork<Cap, Index>::index_type searchLimit, const Deadline* deadline,
+		FlowWorkspace<Index>& workspace)
+	{
+		typename FlowTotal<Cap>::type flow = 0;
+		Index numNodes = g.nodes();
+		if ((source < 0) || (source >= numNodes) || (sink < 0) || (sink >= numNodes) || (source == sink))
+			return flow;
+
+		for (Index a = g.first[source]; a < g.first[source + 1]; ++a)
+		{
+			Index v = g.head[a];
+			for (Index b = g.first[v]; b < g.first[v + 1] && g.cap[a] > 0; ++b)
+			{
+				if (g.head[b] == sink && g.cap[b] > 0)
+				{
+					Cap pushed = std::min(g.cap[a], g.cap[b]);
+					g.cap[a] -= pushed;
+					g.cap[g.rev[a]] += pushed;
+					g.cap[b] -= pushed;
+					g.cap[g.rev[b]] += pushed;
+					flow += pushed;
+				}
+			}
+		}
+		if (searchLimit <= 0)
+			return flow;
+
+		// The source is stamped as visited by every search so that no path runs back through it
+		workspace.prepare(numNodes);
+		std::vector<Index>& parentArc = workspace.parentArc;
+		std::vector<int>& visited = workspace.visited;
+		std::vector<Index>& queue = workspace.queue;
+		int& epoch = workspace.epoch;
+		for (Index a = g.first[source]; a < g.first[source + 1]; ++a)
+		{
+			if (deadline && std::chrono::steady_clock::now() >= *deadline)
+				break;
+			Index v = g.head[a];
+			while (g.cap[a] > 0 && v != sink)
+			{
+				++epoch;
+				visited[source] = epoch;
+				visited[v] = epoch;
+				queue.assign(1, v);
+
+				bool found = false;
+				for (size_t next = 0; next < queue.size() && !found; ++next)
+				{
+					Index currentNode = queue[next];
+					for (Index b = g.first[currentNode]; b < g.first[currentNode + 1]; ++b)
+					{
+						Index neighbor = g.head[b];
+						if (g.cap[b] <= 0 || visited[neighbor] == epoch)
+							continue;
+						visited[neighbor] = epoch;
+						parentArc[neighbor] = b;
+						if (neighbor == sink)
+						{
+							found = true;
+							break;
+						}
+						if (static_cast<Index>(queue.size()) < searchLimit)
+							queue.push_back(neighbor);
+					}
+				}
+				if (!found)
+					break;
+
+				// Push the minimum residual capacity along the path, including the arc from the source
+				Cap pushed = g.cap[a];
+				for (Index u = sink; u != v; u = g.head[g.rev[parentArc[u]]])
+					pushed = std::min(pushed, g.cap[parentArc[u]]);
+				for (Index u = sink; u != v; u = g.head[g.rev[parentArc[u]]])
+				{
+					g.cap[parentArc[u]] -= pushed;
+					g.cap[g.rev[parentArc[u]]] += pushed;
+				}
+				g.cap[a] -= pushed;
+				g.cap[g.rev[a]] += pushed;
+				flow += pushed;
+			}
+		}
+		return flow;
+	}
+
+	//! @brief greedyFlow with search buffers of its own
+	template<typename Cap, typename Index>
+	typename FlowTotal<Cap>::type greedyFlow(FlowNetwork<Cap, Index>& g,
+		typename FlowNetwork<Cap, Index>::index_type source, typename FlowNetwork<Cap, Index>::index_type sink,
+		typename FlowNetwork<Cap, Index>::index_type searchLimit, const Deadline* deadline = NULL)
+	{
+		FlowWorkspace<Index> workspace;
+		return greedyFlow(g, source, sink, searchLimit, deadline, workspace);
+	}
+
+	//! @brief Ford fulkerson algorithm on a flat residual network, augmenting along shortest paths
+	//! @param g The network on which to perform the algorithm. Its residual capacities are updated in place.
+	//! @param source
+	//! @param sink
+	//! @param initialFlow Flow already pushed from the source to the sink in g's residual capacities, for example by
+	//!	 greedyFlow. The augmenting paths start from that flow instead of from zero.
+	//! @param deadline If given, stop augmenting once this time has passed. boundingCut then tells how far the flow
+	//!	 returned is from the maximum.
+	//! @param workspace Search buffers, kept by the caller across calls
+	//! @param checkpoint If given, told of every arc whose residual capacity changes, and asked to save a snapshot
+	//!	 whenever one is due
+	//! @retval The maximum flow for the given network, including the initial flow, or the flow reached by the deadline
+	template<typename Cap, typename Index>
+	typename FlowTotal<Cap>::type fordFulkerson(FlowNetwork<Cap, Index>& g,
+		typename FlowNetwork<Cap, Index>::index_type source, typename FlowNetwork<Cap, Index>::index_type sink,
+		typename FlowTotal<Cap>::type initialFlow, const Deadline* deadline, FlowWorkspace<Index>& workspace,
+		FlowCheckpoint<Cap, Index>* checkpoint = NULL)
+	{
+		typename FlowTotal<Cap>::type maxFlow = initialFlow;
+		Index numNodes = g.nodes();
+		if ((source < 0) || (source >= numNodes) || (sink < 0) || (sink >= numNodes) || (source == sink))
+			return maxFlow;
+
+		// Search buffers are reused by every augmentation
+		workspace.prepare(numNodes);
+		std::vector<Index>& parentArc = workspace.parentArc;
+
+		while (residualSearch(g, source, sink, parentArc, workspace.visited, ++workspace.epoch, workspace.queue))
+		{
+			// Find the minimum residual capacity along the path
+			Cap minCapacity = std::numeric_limits<Cap>::max();
+			for (Index v = sink; v != source; v = g.head[g.rev[parentArc[v]]])
+				minCapacity = std::min(minCapacity, g.cap[parentArc[v]]);
+
+			// Move that much capacity from each arc on the path to its reverse arc
+			for (Index v = sink; v != source; v = g.head[g.rev[parentArc[v]]])
+			{
+				Index a = parentArc[v];
+				g.cap[a] -= minCapacity;
+				g.cap[g.rev[a]] += minCapacity;
+				if (checkpoint)
+				{
+					checkpoint->touch(a);
+					checkpoint->touch(g.rev[a]);
+				}
+			}
+
+			// Accumulate the flow to return the maximum flow
+			maxFlow += minCapacity;
+			if (checkpoint && checkpoint->due())
+				checkpoint->save(g, maxFlow);
+
+			if (deadline && std::chrono::steady_clock::now() >= *deadline)
+				break;
+		}
+		return maxFlow;
+	}
+
+	//! @brief fordFulkerson with search buffers of its own
+	template<typename Cap, typename Index>
+	typename FlowTotal<Cap>::type fordFulkerson(FlowNetwork<Cap, Index>& g,
+		typename FlowNetwork<Cap, Index>::index_type source, typename FlowNetwork<Cap, Index>::index_type sink,
+		typename FlowTotal<Cap>::type initialFlow = 0, const Deadline* deadline = NULL)
+	{
+		FlowWorkspace<Index> workspace;
+		return fordFulkerson(g, source, sink, initialFlow, deadline, workspace);
+	}
+
+	//! @brief Finds the source side of the minimum cut left in a residual network by fordFulkerson
+	//! @param g The residual network after the maximum flow has been found
+	//! @param source The source the flow was pushed from
+	//! @param sourceSide Filled with true for every node that is still reachable from the source
+	template<typename Cap, typename Index>
+	void minCut(const FlowNetwork<Cap, Index>& g, typename FlowNetwork<Cap, Index>::index_type source,
+		std::vector<bool>& sourceSide)
+	{
+		sourceSide.assign(g.nodes(), false);
+		if (source < 0 || source >= g.nodes())
+			return;
+
+		std::vector<Index> queue(1, source);
+		sourceSide[source] = true;
+		for (size_t next = 0; next < queue.size(); ++next)
+		{
+			Index currentNode = queue[next];
+			for (Index a = g.first[currentNode]; a < g.first[currentNode + 1]; ++a)
+			{
+				if (g.cap[a] > 0 && !sourceSide[g.head[a]])
+				{
+					sourceSide[g.head[a]] = true;
+					queue.push_back(g.head[a]);
+				}
+			}
+		}
+	}
+
+	//! @brief Adds up the original capacities of the arcs leaving one side of a cut
+	//! @param g The network
+	//! @param sourceSide True for every node on the source side of the cut
+	//! @retval The capacity of the cut
+	template<typename Cap, typename Index>
+	typename FlowTotal<Cap>::type cutCapacity(const FlowNetwork<Cap, Index>& g, const std::vector<bool>& sourceSide)
+	{
+		typename FlowTotal<Cap>::type capacity = 0;
+		for (Index u = 0; u < g.nodes(); ++u)
+			if (sourceSide[u])
+				for (Index a = g.first[u]; a < g.first[u + 1]; ++a)
+					if (!sourceSide[g.head[a]])
+						capacity += g.base[a];
+		return capacity;
+	}
+
+	//! @brief Finds a cut between the source and the sink in a residual network, whether or not its flow is maximal.
+	//!	 Its capacity bounds the maximum flow from above, just as the current flow bounds it from below.
+	//! @note Two cuts are tried: the nodes the source can still reach without passing the sink, and the nodes that
+	//!	 cannot reach the sink without passing the source. The one with the smaller capacity is kept, preferring the
+	//!	 first. Once the flow is maximal both are minimum cuts and the first is the one minCut finds.
+	//! @param g The residual network
+	//! @param source
+	//! @param sink
+	//! @param sourceSide Filled with true for every node on the source side of the cut
+	//! @param workspace Search buffers, kept by the caller across calls
+	//! @retval The capacity of the cut, which equals the flow only if the flow is maximal
+	template<typename Cap, typename Index>
+	typename FlowTotal<Cap>::type boundingCut(const FlowNetwork<Cap, Index>& g,
+		typename FlowNetwork<Cap, Index>::index_type source, typename FlowNetwork<Cap, Index>::index_type sink,
+		std::vector<bool>& sourceSide, FlowWorkspace<Index>& workspace)
+	{
+		sourceSide.assign(g.nodes(), false);
+		if ((source < 0) || (source >= g.nodes()) || (sink < 0) || (sink >= g.nodes()) || (source == sink))
+			return 0;
+
+		// Forward along arcs with residual capacity, never leaving the sink
+		workspace.prepare(g.nodes());
+		std::vector<Index>& queue = workspace.queue;
+		queue.assign(1, source);
+		sourceSide[source] = true;
+		for (size_t next = 0; next < queue.size(); ++next)
+		{
+			Index currentNode = queue[next];
+			if (currentNode == sink)
+				continue;
+			for (Index a = g.first[currentNode]; a < g.first[currentNode + 1]; ++a)
+			{
+				if (g.cap[a] > 0 && !sourceSide[g.head[a]] && g.head[a] != sink)
+				{
+					sourceSide[g.head[a]] = true;
+					queue.push_back(g.head[a]);
+				}
+			}
+		}
+		typename FlowTotal<Cap>::type forwardCapacity = cutCapacity(g, sourceSide);
+
+		// Backward from the sink: a node u reaches v if the reverse of one of v's arcs, u -> v, has residual capacity
+		std::vector<bool>& sinkSide = workspace.marks;
+		sinkSide.assign(g.nodes(), false);
+		queue.assign(1, sink);
+		sinkSide[sink] = true;
+		for (size_t next = 0; next < queue.size(); ++next)
+		{
+			Index currentNode = queue[next];
+			for (Index a = g.first[currentNode]; a < g.first[currentNode + 1]; ++a)
+			{
+				Index u = g.head[a];
+				if (g.cap[g.rev[a]] > 0 && !sinkSide[u] && u != source)
+				{
+					sinkSide[u] = true;
+					queue.push_back(u);
+				}
+			}
+		}
+		sinkSide.flip();
+		typename FlowTotal<Cap>::type backwardCapacity = cutCapacity(g, sinkSide);
+
+		if (backwardCapacity < forwardCapacity)
+		{
+			sourceSide.swap(sinkSide);
+			return backwardCapacity;
+		}
+		return forwardCapacity;
+	}
+
+	//! @brief boundingCut with search buffers of its own
+	template<typename Cap, typename Index>
+	typename FlowTotal<Cap>::type boundingCut(const FlowNetwork<Cap, Index>& g,
+		typename FlowNetwork<Cap, Index>::index_type source, typename FlowNetwork<Cap, Index>::index_type sink,
+		std::vector<bool>& sourceSide)
+	{
+		FlowWorkspace<Index> workspace;
+		return boundingCut(g, source, sink, sourceSide, workspace);
+	}
+
+	//! @brief Checks that every pair of nodes has as much capacity one way as the other, added up over every arc
+	//!	 between them. Only then do the minimum cuts of the network form a cut tree.
+	//! @param g The network
+	//! @retval true if the capacities are symmetric
+	template<typename Cap, typename Index>
+	bool symmetricCapacities(const FlowNetwork<Cap, Index>& g)
+	{
+		// Capacity from the lower numbered node of each pair counts up, capacity from the higher one down
+		typedef std::pair< std::pair<Index, Index>, typename FlowTotal<Cap>::type > pairCapacity;
+		std::vector<pairCapacity> pairs;
+		for (Index u = 0; u < g.nodes(); ++u)
+		{
+			for (Index a = g.first[u]; a < g.first[u + 1]; ++a)
+			{
+				Index v = g.head[a];
+				if (g.base[a] > 0 && u != v)
+					pairs.push_back((u < v) ? pairCapacity(std::make_pair(u, v), g.base[a])
+						: pairCapacity(std::make_pair(v, u), -static_cast<typename FlowTotal<Cap>::type>(g.base[a])));
+			}
+		}
+		std::sort(pairs.begin(), pairs.end());
+
+		for (size_t i = 0; i < pairs.size();)
+		{
+			typename FlowTotal<Cap>::type balance = 0;
+			size_t j = i;
+			for (; j < pairs.size() && pairs[j].first == pairs[i].first; ++j)
+				balance += pairs[j].second;
+			if (balance != 0)
+				return false;
+			i = j;
+		}
+		return true;
+	}
+
+	//! @brief Cut tree of a network with symmetric capacities, as built by cutTree. The minimum cut between any two
+	//!	 nodes is the lightest edge on the path between them in the tree. Like a Gomory-Hu tree it gives the capacity
+	//!	 of every minimum cut, though the two sides of a tree edge need not be a minimum cut themselves.
+	template<typename Cap, typename Index>
+	struct CutTree
+	{
+		std::vector<Index> parent;	//! Neighbor of each node on the way to node 0, always numbered lower; -1 for node 0
+		std::vector<typename FlowTotal<Cap>::type> weight;	//! Minimum cut between each node and its parent
+		std::vector<Index> depth;	//! Edges from each node to node 0
+
+		//! @brief Looks up the minimum cut between two nodes
+		//! @param u One node
+		//! @param v Another node
+		//! @retval The capacity of the minimum cut separating them
+		typename FlowTotal<Cap>::type minCut(Index u, Index v) const
+		{
+			typename FlowTotal<Cap>::type cut = std::numeric_limits<typename FlowTotal<Cap>::type>::max();
+			while (u != v)
+			{
+				if (depth[u] < depth[v])
+					std::swap(u, v);
+				cut = std::min(cut, weight[u]);
+				u = parent[u];
+			}
+			return cut;
+		}
+	};
+
+	//! @brief Builds the cut tree of a network with Gusfield's algorithm: one maximum flow from each node but the
+	//!	 first to its current parent, with the capacities reset from base before each. Nodes on the source side of
+	//!	 each cut that shared the same parent move under the node just solved.
+	//! @param g The network, which must have symmetric capacities. Its residual capacities are reset when done.
+	//! @param tree Filled with the tree
+	template<typename Cap, typename Index>
+	void cutTree(FlowNetwork<Cap, Index>& g, CutTree<Cap, Index>& tree)
+	{
+		Index numNodes = g.nodes();
+		tree.parent.assign(numNodes, 0);
+		tree.weight.assign(numNodes, 0);
+		tree.depth.assign(numNodes, 0);
+		if (numNodes == 0)
+			return;
+		tree.parent[0] = -1;
+
+		FlowWorkspace<Index> workspace;
+		std::vector<bool> sourceSide;
+		for (Index s = 1; s < numNodes; ++s)
+		{
+			Index t = tree.parent[s];
+			g.reset();
+			tree.weight[s] = fordFulkerson(g, s, t, 0, NULL, workspace);
+			minCut(g, s, sourceSide);
+			for (Index v = s + 1; v < numNodes; ++v)
+				if (sourceSide[v] && tree.parent[v] == t)
+					tree.parent[v] = s;
+		}
+		g.reset();
+
+		// Parents are numbered below their children, so each depth is known before it is needed
+		for (Index v = 1; v < numNodes; ++v)
+			tree.depth[v] = tree.depth[tree.parent[v]] + 1;
+	}
+
+	//! @brief Writes the flow and minimum cut of a solved network in DIMACS solution format
+	//! @param file The name of the file to be written
+	//! @param g The residual network after the maximum flow has been found
+	//! @param maxFlow The value of the maximum flow
+	//! @retval true if successful, false otherwise
+	/*
+		@note The file holds an "s <flow>" line, an "f <from> <to> <flow>" line for every arc carrying flow, and an
+		 "n <id> s|t" line placing every vertex on the source or sink side of the cut. Vertices are numbered from 1.
+	*/
+	template<typename Cap, typename Index>
+	bool writeDimacsSolution(const char* file, const FlowNetwork<Cap, Index>& g,
+		typename FlowTotal<Cap>::type maxFlow)
+	{
+		std::ofstream output;
+		output.open(file);
+		if (!output)
+		{
+			std::cerr << "Could not open file: " << file << "\n";
+			return false;
+		}
+
+		output << "c Max flow from " << (g.source + 1) << " to " << (g.sink + 1) << "\n";
+		output << "s " << maxFlow << "\n";
+
+		// Flow on each original arc is what has been taken from its capacity
+		for (Index u = 0; u < g.nodes(); ++u)
+			for (Index a = g.first[u]; a < g.first[u + 1]; ++a)
+				if (g.base[a] > 0 && g.base[a] > g.cap[a])
+					output << "f " << (u + 1) << " " << (g.head[a] + 1) << " " << (g.base[a] - g.cap[a]) << "\n";
+
+		std::vector<bool> sourceSide;
+		minCut(g, g.source, sourceSide);
+		for (Index u = 0; u < g.nodes(); ++u)
+			output << "n " << (u + 1) << (sourceSide[u] ? " s" : " t") << "\n";
+
+		output.close();
+		return !output.fail();
+	}
+}
@@ -5,31 +5,520 @@
 	@copyright Copyright 2014 Guarnera, Bogadamidi, Michaud. All rights reserved.
 */
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
 #include "tools.hpp"
-#include "graph.hpp"
+#include "network.hpp"
 #include "pgm.hpp"
 
-int main(int argc, char* argv[])
+namespace
 {
-	Graph inputGraph;
+	//! @brief Prints the shortest paths from one vertex to others, found by a single search (option -b)
+	struct searchAction
+	{
+		int64_t startVertex;			//! Starting vertex
+		std::vector<int64_t> endPoints;	//! Ending vertices
+
+		searchAction(int64_t start, const std::vector<int64_t>& ends) : startVertex(start), endPoints(ends) {}
+
+		template<typename Cap, typename Index>
+		bool operator()(FlowNetwork<Cap, Index>& inputGraph) const
+		{
+			// Check every vertex before narrowing it to the network's index type
+			if (startVertex < 0 || startVertex >= inputGraph.nodes())
+			{
+				std::cerr << "Invalid start vertex: " << startVertex << "\n";
+				return false;
+			}
+			std::vector<Index> ends;
+			for (size_t i = 0; i < endPoints.size(); ++i)
+			{
+				if (endPoints[i] < 0 || endPoints[i] >= inputGraph.nodes())
+				{
+					std::cerr << "Invalid end vertex: " << endPoints[i] << "\n";
+					return false;
+				}
+				ends.push_back(static_cast<Index>(endPoints[i]));
+			}
+			Tools::SearchTree<Cap, Index> tree;
+			Tools::searchTree(inputGraph, static_cast<Index>(startVertex), ends, tree);
+
+			for (size_t i = 0; i < ends.size(); ++i)
+			{
+				Index endPoint = ends[i];
+				if (!tree.reached(endPoint))
+				{
+					std::cerr << "No path found from " << startVertex << " to " << endPoint << "\n";
+					continue;
+				}
+
+				std::vector<Index> shortestPath;	// Shortest path p along graph G
+				tree.path(endPoint, shortestPath);
+
+				// Output
+				std::cerr << "Found shortest path from " << startVertex << " to "
+					<< endPoint << " to be: " << tree.distance[endPoint] << " edge(s).\n";
+
+				std::cout << "Path: ";
+				for (size_t j = 0; j < shortestPath.size(); ++j)
+				{
+					std::cout << shortestPath[j];
+
+					if (j + 1 < shortestPath.size())
+						std::cout << " --> ";
+				}
+
+				std::cout << "\n";
+			}
+			return true;
+		}
+	};
+
+	//! @brief Orders queries by their start vertex, keeping the file order among queries with the same start
+	struct byStart
+	{
+		const std::vector<int64_t>* starts;	//! Start vertex of each query
+
+		bool operator()(size_t a, size_t b) const
+		{
+			return ((*starts)[a] != (*starts)[b]) ? ((*starts)[a] < (*starts)[b]) : (a < b);
+		}
+	};
+
+	//! @brief Answers a file of shortest path queries, with one search per distinct start vertex (option -q)
+	struct queryAction
+	{
+		const char* queries;	//! Query file
+
+		queryAction(const char* file) : queries(file) {}
+
+		template<typename Cap, typename Index>
+		bool operator()(FlowNetwork<Cap, Index>& inputGraph) const
+		{
+			std::ifstream input(queries);
+			if (!input)
+			{
+				std::cerr << "Could not open file: " << queries << "\n";
+				return false;
+			}
+
+			// Read the whole batch first. An end of * asks for every vertex, stored as -1.
+			std::vector<int64_t> starts, ends;
+			std::string startText, endText;
+			while (input >> startText >> endText)
+			{
+				int64_t start = atoll(startText.c_str());
+				int64_t end = (endText == "*") ? -1 : atoll(endText.c_str());
+				if (start < 0 || start >= inputGraph.nodes() || end < -1 || end >= inputGraph.nodes()
+					|| (end == -1 && endText != "*"))
+				{
+					std::cerr << "Invalid query: " << startText << " " << endText << "\n";
+					return false;
+				}
+				starts.push_back(start);
+				ends.push_back(end);
+			}
+
+			std::vector<size_t> order(starts.size());
+			for (size_t i = 0; i < order.size(); ++i)
+				order[i] = i;
+			byStart compare = { &starts };
+			std::sort(order.begin(), order.end(), compare);
+
+			// Queries sharing a start are answered from one search, stopped once all their ends are reached
+			std::vector<std::string> answers(starts.size());
+			Tools::SearchTree<Cap, Index> tree;
+			size_t searches = 0;
+			for (size_t i = 0; i < order.size(); ++searches)
+			{
+				size_t j = i;
+				bool everyVertex = false;
+				std::vector<Index> targets;
+				for (; j < order.size() && starts[order[j]] == starts[order[i]]; ++j)
+				{
+					everyVertex = everyVertex || (ends[order[j]] < 0);
+					targets.push_back(static_cast<Index>(ends[order[j]]));
+				}
+				if (everyVertex)
+					targets.clear();
+				Tools::searchTree(inputGraph, static_cast<Index>(starts[order[i]]), targets, tree);
+
+				for (; i < j; ++i)
+				{
+					std::stringstream answer;
+					if (ends[order[i]] >= 0)
+						describe(tree, static_cast<Index>(ends[order[i]]), answer);
+					else
+						for (Index v = 0; v < inputGraph.nodes(); ++v)
+							if (v != tree.start && tree.reached(v))
+								describe(tree, v, answer);
+					answers[order[i]] = answer.str();
+				}
+			}
+
+			for (size_t i = 0; i < answers.size(); ++i)
+				std::cout << answers[i];
+			std::cerr << "Answered " << answers.size() << " quer" << ((answers.size() == 1) ? "y" : "ies") << " with "
+				<< searches << " search(es)\n";
+			return input.eof();
+		}
+
+		//! @brief Writes one answer: the start, the end, then the number of edges, the smallest residual capacity
+		//!	 and the vertices of the path, or -1 if the end cannot be reached
+		template<typename Cap, typename Index>
+		static void describe(const Tools::SearchTree<Cap, Index>& tree, Index end, std::ostream& output)
+		{
+			output << tree.start << " " << end;
+			if (!tree.reached(end))
+			{
+				output << " -1\n";
+				return;
+			}
+
+			std::vector<Index> path;
+			tree.path(end, path);
+			output << " " << tree.distance[end] << " " << ((end == tree.start) ? Cap(0) : tree.bottleneck[end]);
+			for (size_t i = 0; i < path.size(); ++i)
+				output << " " << path[i];
+			output << "\n";
+		}
+	};
+
+	//! @brief Prints the maximum flow and optionally writes it as a DIMACS solution (option -f)
+	struct maxFlowAction
+	{
+		const char* solution;	//! Solution file, or NULL
+		const char* checkpoint;	//! Checkpoint file, or NULL
+		long interval;			//! Milliseconds between snapshots, 0 for one after every augmentation
+		bool resume;			//! Start from the snapshot in the checkpoint file
+
+		maxFlowAction(const char* file, const char* checkpointFile, long milliseconds, bool resumeSolve)
+			: solution(file), checkpoint(checkpointFile), interval(milliseconds), resume(resumeSolve) {}
+
+		template<typename Cap, typename Index>
+		bool operator()(FlowNetwork<Cap, Index>& inputGraph) const
+		{
+			// DIMACS files name their own source and sink, other graphs run from the first to the last vertex
+			typename Tools::FlowTotal<Cap>::type maxFlow = 0;
+			if (!checkpoint)
+				maxFlow = Tools::fordFulkerson(inputGraph, inputGraph.source, inputGraph.sink);
+			else
+			{
+				// Carry on from the last snapshot, or start a new checkpoint file. A file that cannot be resumed is
+				// left as it is.
+				Tools::FlowCheckpoint<Cap, Index> snapshots;
+				if (resume)
+				{
+					if (!snapshots.resume(checkpoint, inputGraph, maxFlow, interval))
+						return false;
+					std::cerr << "Resumed from a flow of " << maxFlow << "\n";
+				}
+				else if (!snapshots.create(checkpoint, inputGraph, maxFlow, interval))
+					return false;
+
+				Tools::FlowWorkspace<Index> workspace;
+				maxFlow = Tools::fordFulkerson(inputGraph, inputGraph.source, inputGraph.sink, maxFlow, NULL, workspace,
+					&snapshots);
+				if (!snapshots.finish(inputGraph, maxFlow))
+					return false;
+			}
+			std::cerr << "Max flow is " << maxFlow << "\n";
+
+			// Optionally write the flow and cut as a DIMACS solution
+			return !solution || Tools::writeDimacsSolution(solution, inputGraph, maxFlow);
+		}
+	};
+
+	//! @brief Builds the cut tree of a network and answers minimum cut queries from it (option -g)
+	struct cutTreeAction
+	{
+		const char* queries;	//! File of node pairs, or NULL to print the tree
+
+		cutTreeAction(const char* file) : queries(file) {}
+
+		template<typename Cap, typename Index>
+		bool operator()(FlowNetwork<Cap, Index>& inputGraph) const
+		{
+			if (!Tools::symmetricCapacities(inputGraph))
+			{
+				std::cerr << "Cut trees need symmetric capacities, with as much capacity from each vertex to another as back\n";
+				return false;
+			}
+
+			Tools::CutTree<Cap, Index> tree;
+			Tools::cutTree(inputGraph, tree);
+			std::cerr << "Built a cut tree of " << inputGraph.nodes() << " vertices with "
+				<< std::max<Index>(0, inputGraph.nodes() - 1) << " max flow(s)\n";
+
+			// Without queries, print each vertex with its parent in the tree and the minimum cut between them
+			if (!queries)
+			{
+				for (Index v = 1; v < inputGraph.nodes(); ++v)
+					std::cout << v << " " << tree.parent[v] << " " << tree.weight[v] << "\n";
+				return true;
+			}
+
+			std::ifstream input(queries);
+			if (!input)
+			{
+				std::cerr << "Could not open file: " << queries << "\n";
+				return false;
+			}
+
+			// One pair of vertices per line; each answer is a walk up the tree
+			int64_t u, v;
+			while (input >> u >> v)
+			{
+				if (u < 0 || v < 0 || u >= inputGraph.nodes() || v >= inputGraph.nodes() || u == v)
+				{
+					std::cerr << "Invalid query: " << u << " " << v << "\n";
+					return false;
+				}
+				std::cout << u << " " << v << " " << tree.minCut(u, v) << "\n";
+			}
+			return input.eof();
+		}
+	};
+
+	//! @brief Writes a graph as a binary network with the narrowest types that hold it (option -c)
+	struct convertAction
+	{
+		const char* output;	//! Binary network file
+
+		convertAction(const char* file) : output(file) {}
+
+		template<typename Cap, typename Index>
+		bool operator()(FlowNetwork<Cap, Index>& inputGraph) const
+		{
+			if (!std::numeric_limits<Cap>::is_integer)
+				return write(inputGraph, inputGraph);
+
+			// An arc's residual capacity can grow to its own capacity plus that of its reverse arc
+			int64_t largest = 0;
+			for (Index a = 0; a < inputGraph.arcs(); ++a)
+				largest = std::max(largest, static_cast<int64_t>(inputGraph.base[a])
+					+ static_cast<int64_t>(inputGraph.base[inputGraph.rev[a]]));
+			bool narrowIndex = static_cast<int64_t>(inputGraph.nodes()) < INT32_MAX
+				&& static_cast<int64_t>(inputGraph.arcs()) <= INT32_MAX;
+
+			if (largest <= INT16_MAX)
+				return narrowIndex ? narrow<int16_t, int32_t>(inputGraph) : narrow<int16_t, int64_t>(inputGraph);
+			if (largest <= INT32_MAX)
+				return narrowIndex ? narrow<int32_t, int32_t>(inputGraph) : narrow<int32_t, int64_t>(inputGraph);
+			return narrowIndex ? narrow<int64_t, int32_t>(inputGraph) : narrow<int64_t, int64_t>(inputGraph);
+		}
+
+		template<typename Cap, typename Index, typename FromCap, typename FromIndex>
+		bool narrow(FlowNetwork<FromCap, FromIndex>& inputGraph) const
+		{
+			FlowNetwork<Cap, Index> narrowed;
+			return narrowed.assign(inputGraph) && write(inputGraph, narrowed);
+		}
+
+		template<typename Cap, typename Index, typename FromCap, typename FromIndex>
+		bool write(FlowNetwork<FromCap, FromIndex>& inputGraph, FlowNetwork<Cap, Index>& outputGraph) const
+		{
+			if (!outputGraph.writeBinary(output))
+				return false;
+			std::cerr << "Wrote " << outputGraph.nodes() << " node(s) and " << outputGraph.arcs() << " arc(s) with "
+				<< sizeof(Cap) << " byte capacities to " << output << "\n";
+			return true;
+		}
+	};
+
+	//! @brief Loads a binary network with the index type it was written with and runs an action on it
+	template<typename Cap, typename Action>
+	bool withIndex(const char* file, const NetworkFile::header& h, const Action& action)
+	{
+		if (h.indexBytes == sizeof(int32_t))
+		{
+			FlowNetwork<Cap, int32_t> inputGraph;
+			return inputGraph.fromBinary(file) && action(inputGraph);
+		}
+		if (h.indexBytes == sizeof(int64_t))
+		{
+			FlowNetwork<Cap, int64_t> inputGraph;
+			return inputGraph.fromBinary(file) && action(inputGraph);
+		}
+		std::cerr << "Unsupported index size in binary network file: " << file << "\n";
+		return false;
+	}
+
+	//! @brief Loads a graph file and runs an action on it. Binary networks are loaded with the types they were written
+	//!	 with; text and DIMACS graphs with 64 bit capacities.
+	//! @param file Path to the graph file
+	//! @param action The action to run, called with the loaded network
+	//! @retval true if the graph was loaded and the action succeeded
+	template<typename Action>
+	bool withNetwork(const char* file, const Action& action)
+	{
+		if (NetworkFile::detect(file) != NetworkFile::BINARY)
+		{
+			FlowNetwork<int64_t, int32_t> inputGraph;
+			return inputGraph.load(file) && action(inputGraph);
+		}
 
+		NetworkFile::header h;
+		if (!NetworkFile::readHeader(file, h))
+			return false;
+		if (h.capacityIsFloat && h.capacityBytes == sizeof(float))
+			return withIndex<float>(file, h, action);
+		if (!h.capacityIsFloat && h.capacityBytes == sizeof(int16_t))
+			return withIndex<int16_t>(file, h, action);
+		if (!h.capacityIsFloat && h.capacityBytes == sizeof(int32_t))
+			return withIndex<int32_t>(file, h, action);
+		if (!h.capacityIsFloat && h.capacityBytes == sizeof(int64_t))
+			return withIndex<int64_t>(file, h, action);
+		std::cerr << "Unsupported capacity type in binary network file: " << file << "\n";
+		return false;
+	}
+}
+
+int main(int argc, char* argv[])
+{
 	if (argc < 2)
 	{
 		std::cerr << "No options found!\n";
 		return 1;
 	}
 
+	// Settings given as long options apply to the options that follow them
+	static struct option longOptions[] = {
+		{ "time-budget", required_argument, NULL, 'T' },
+		{ "weight", required_argument, NULL, 'W' },
+		{ "sigma", required_argument, NULL, 'S' },
+		{ "threads", required_argument, NULL, 'P' },
+		{ "no-components", no_argument, NULL, 'N' },
+		{ "merge-flat", required_argument, NULL, 'M' },
+		{ "cache", required_argument, NULL, 'C' },
+		{ "cache-size", required_argument, NULL, 'Z' },
+		{ "checkpoint", required_argument, NULL, 'K' },
+		{ "resume", required_argument, NULL, 'R' },
+		{ "checkpoint-interval", required_argument, NULL, 'I' },
+		{ NULL, 0, NULL, 0 } };
+	Tools::segmentOptions segmentation;
+	const char* checkpoint = NULL;
+	long checkpointInterval = 10000;
+	bool resume = false;
+
 	// Process CLI ARGs
 	while(true)
 	{
-		int option = getopt(argc,argv, "bif");
+		int option = getopt_long(argc, argv, "bifctsgq", longOptions, NULL);
 
 		if (option == -1)
 			return 0;
 
+		// Time Budget Setting
+		if (option == 'T')
+		{
+			segmentation.timeBudget = atol(optarg);
+			if (segmentation.timeBudget <= 0)
+			{
+				std::cerr << "Invalid use of option --time-budget\n";
+				std::cerr << "Usage: --time-budget [milliseconds]\n";
+				return 1;
+			}
+		}
+
+		// Weight Function Setting
+		if (option == 'W')
+		{
+			std::string name = optarg;
+			if (name == "linear")
+				segmentation.weight = WeightTable::LINEAR;
+			else if (name == "gaussian")
+				segmentation.weight = WeightTable::GAUSSIAN;
+			else
+			{
+				std::cerr << "Invalid use of option --weight\n";
+				std::cerr << "Usage: --weight [linear|gaussian]\n";
+				return 1;
+			}
+		}
+
+		// Gaussian Spread Setting
+		if (option == 'S')
+		{
+			segmentation.sigma = atof(optarg);
+			if (segmentation.sigma <= 0)
+			{
+				std::cerr << "Invalid use of option --sigma\n";
+				std::cerr << "Usage: --sigma [intensity levels]\n";
+				return 1;
+			}
+		}
+
+		// Solver Thread Setting
+		if (option == 'P')
+		{
+			segmentation.threads = atoi(optarg);
+			if (segmentation.threads <= 0)
+			{
+				std::cerr << "Invalid use of option --threads\n";
+				std::cerr << "Usage: --threads [count]\n";
+				return 1;
+			}
+		}
+
+		// Whole Image Setting
+		if (option == 'N')
+			segmentation.components = false;
+
+		// Flat Region Setting
+		if (option == 'M')
+		{
+			segmentation.mergeFlat = true;
+			segmentation.flatTolerance = atoi(optarg);
+			if (segmentation.flatTolerance < 0)
+			{
+				std::cerr << "Invalid use of option --merge-flat\n";
+				std::cerr << "Usage: --merge-flat [intensity levels]\n";
+				return 1;
+			}
+		}
+
+		// Result Cache Settings
+		if (option == 'C')
+			segmentation.cacheDirectory = optarg;
+		if (option == 'Z')
+		{
+			long megabytes = atol(optarg);
+			if (megabytes <= 0)
+			{
+				std::cerr << "Invalid use of option --cache-size\n";
+				std::cerr << "Usage: --cache-size [MB]\n";
+				return 1;
+			}
+			segmentation.cacheBytes = static_cast<uint64_t>(megabytes) << 20;
+		}
+
+		// Max Flow Checkpoint Settings
+		if (option == 'K' || option == 'R')
+		{
+			checkpoint = optarg;
+			resume = (option == 'R');
+		}
+		if (option == 'I')
+		{
+			checkpointInterval = atol(optarg);
+			if (checkpointInterval < 0)
+			{
+				std::cerr << "Invalid use of option --checkpoint-interval\n";
+				std::cerr << "Usage: --checkpoint-interval [milliseconds]\n";
+				return 1;
+			}
+		}
+
 		// BFS Option
 		if (option == 'b')
 		{     
@@ -37,38 +526,36 @@ int main(int argc, char* argv[])
 			if (optind + 2 >= argc)
 			{
 				std::cerr << "Invalid use of option -b\n";
-				std::cerr << "Usage: -b [input file] [start vertex] [end vertex]\n";
+				std::cerr << "Usage: -b [input file] [start vertex] [end vertex] [more end vertices]\n";
 				return 1;
 			}
 		
 			// This will go to BFS Function
-			int startVertex = atoi(argv[optind + 1]);
+			int64_t startVertex = atoll(argv[optind + 1]);
 
 			// Obtain the potential multiple end points specified
-			int optOffset = 2;
-			int endPoint = atoi(argv[optind + optOffset]);
+			std::vector<int64_t> endPoints;
+			for (int optOffset = 2; optind + optOffset < argc && argv[optind + optOffset][0] != '-'; ++optOffset)
+				endPoints.push_back(atoll(argv[optind + optOffset]));
 
 			// Generate graph from file
-			Tools::graphFromFile(argv[optind], inputGraph);
-			
-			std::pair< std::vector<int>, int > searchResult = Tools::breadthFirstSearch(inputGraph, startVertex, endPoint);
-			std::vector<int> shortestPath = searchResult.first;	// Shortest path p along graph G
-			unsigned int numEdges = shortestPath.size() - 1; 	// Edges = Nodes - 1
-
-			// Output
-			std::cerr << "Found shortest path from " << startVertex << " to "
-				<< endPoint << " to be: " << numEdges << " edge(s).\n";
+			if (!withNetwork(argv[optind], searchAction(startVertex, endPoints)))
+				return 1;
+		}
 
-			std::cout << "Path: ";
-			for (unsigned int i = 0; i < shortestPath.size(); ++i)
+		// Batched Path Query Option
+		if (option == 'q')
+		{
+			// Check for two additional options
+			if (optind + 1 >= argc)
 			{
-				std::cout << shortestPath[i];
-
-				if (i + i < shortestPath.size())
-					std::cout << " --> ";
+				std::cerr << "Invalid use of option -q\n";
+				std::cerr << "Usage: -q [input file] [query file]\n";
+				return 1;
 			}
 
-			std::cout << "\n";
+			if (!withNetwork(argv[optind], queryAction(argv[optind+1])))
+				return 1;
 		}
 
 		// Ford-Fulkerson Option
@@ -78,17 +565,30 @@ int main(int argc, char* argv[])
 			if (optind >= argc)
 			{
 				std::cerr << "Invalid use of option -f\n";
-				std::cerr << "Usage: -f [input file]\n";
+				std::cerr << "Usage: -f [input file] [solution file]\n";
 				return 1;
 			}
 
 			// This will go to Ford Fulkerson Function
-			Tools::graphFromFile(argv[optind], inputGraph);
+			const char* solution = (optind + 1 < argc && argv[optind+1][0] != '-') ? argv[optind+1] : NULL;
+			if (!withNetwork(argv[optind], maxFlowAction(solution, checkpoint, checkpointInterval, resume)))
+				return 1;
+		}
 
-			int source = 0;
-			int sink   = inputGraph.sNodes.size() - 1;
-			int maxFlow = Tools::fordFulkerson(inputGraph, source, sink);
-			std::cerr << "Max flow is " << maxFlow << "\n";
+		// Cut Tree Option
+		if (option == 'g')
+		{
+			// Check for at least one additional option
+			if (optind >= argc)
+			{
+				std::cerr << "Invalid use of option -g\n";
+				std::cerr << "Usage: -g [input file] [query file]\n";
+				return 1;
+			}
+
+			const char* queries = (optind + 1 < argc && argv[optind+1][0] != '-') ? argv[optind+1] : NULL;
+			if (!withNetwork(argv[optind], cutTreeAction(queries)))
+				return 1;
 		}
 
 		// Image Segmentation Option
@@ -98,10 +598,73 @@ int main(int argc, char* argv[])
 			if (optind + 1 >= argc)
 			{
 				std::cerr << "Invalid use of option -i\n";
-				std::cerr << "Usage: -i [input file] [ouput file]\n";
+				std::cerr << "Usage: -i [input file] [ouput file] [raster|tiled|morton]\n";
 				return 1;
 			}
-			Tools::segmentImage(argv[optind], argv[optind+1]);
+
+			// Optional numbering of the pixel nodes
+			Tools::segmentOptions options = segmentation;
+			if (optind + 2 < argc && argv[optind+2][0] != '-')
+			{
+				std::string name = argv[optind+2];
+				if (name == "tiled")
+					options.layout = Pgm::TILED;
+				else if (name == "morton")
+					options.layout = Pgm::MORTON;
+				else if (name != "raster")
+				{
+					std::cerr << "Unknown node layout: " << name << "\n";
+					return 1;
+				}
+			}
+			if (!Tools::segmentImage(argv[optind], argv[optind+1], options))
+				return 1;
+		}
+
+		// Out-of-Core Image Segmentation Option
+		if (option == 't')
+		{
+			// Check for at least two additional options
+			if (optind + 1 >= argc)
+			{
+				std::cerr << "Invalid use of option -t\n";
+				std::cerr << "Usage: -t [input file] [ouput file] [memory budget MB]\n";
+				return 1;
+			}
+
+			// Default to a 256 MB budget, with scratch files in TMPDIR
+			size_t budget = 256;
+			if (optind + 2 < argc && argv[optind+2][0] != '-')
+				budget = std::max(1, atoi(argv[optind+2]));
+			const char* directory = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+			if (!Tools::segmentImageTiled(argv[optind], argv[optind+1], budget << 20, directory, segmentation))
+				return 1;
+		}
+
+		// Streaming Image Segmentation Option
+		if (option == 's')
+		{
+			// Images are read from standard input and their cuts written to standard output, with nothing else
+			// sharing the streams, so they need not stay in step with C stdio
+			std::ios::sync_with_stdio(false);
+			if (!Tools::segmentStream(std::cin, std::cout, segmentation))
+				return 1;
+		}
+
+		// Binary Graph Conversion Option
+		if (option == 'c')
+		{
+			// Check for at most two additional options
+			if (optind + 1 >= argc)
+			{
+				std::cerr << "Invalid use of option -c\n";
+				std::cerr << "Usage: -c [input file] [output file]\n";
+				return 1;
+			}
+
+			// Parse the text or DIMACS graph once and store it in a form that later runs can map without parsing
+			if (!withNetwork(argv[optind], convertAction(argv[optind+1])))
+				return 1;
 		}
 	}		
 	return 0;
@@ -0,0 +1,47 @@
+/*
+	@brief C interface for segmenting images that are already in memory. See Segmenter.
+	@author Drew Guarnera, Bharath Bogadamidi, Heather Michaud
+	@version 0.9
+	@copyright Copyright 2014 Guarnera, Bogadamidi, Michaud. All rights reserved.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! @brief A segmenter, holding the buffers reused from one image to the next
+typedef struct iseg_segmenter iseg_segmenter;
+
+//! @brief Creates a segmenter with the default options
+//! @retval The segmenter, or NULL if it could not be allocated
+iseg_segmenter* iseg_create(void);
+
+//! @brief Frees a segmenter and all of its buffers
+//! @param segmenter The segmenter, or NULL
+void iseg_destroy(iseg_segmenter* segmenter);
+
+//! @brief Sets how long each call to iseg_segment may take before it writes the best cut found so far
+//! @param segmenter The segmenter
+//! @param milliseconds The time budget, or 0 for no limit
+void iseg_set_time_budget(iseg_segmenter* segmenter, long milliseconds);
+
+//! @brief Segments one image. The pixels and mask belong to the caller and are not kept after the call.
+//! @param segmenter The segmenter
+//! @param pixels First pixel of the top row
+//! @param width Pixels per row
+//! @param height Number of rows
+//! @param stride Bytes from the start of one row to the start of the next
+//! @param depth Bits per pixel, 1 to 16. Pixels of more than 8 bits take two bytes, in native byte order.
+//! @param mask Set to 1 for every foreground pixel and 0 for the rest, one byte per pixel
+//! @param mask_stride Bytes from the start of one row of the mask to the start of the next
+//! @retval 0 if successful, -1 otherwise
+int iseg_segment(iseg_segmenter* segmenter, const void* pixels, int width, int height, size_t stride, int depth,
+	unsigned char* mask, size_t mask_stride);
+
+#ifdef __cplusplus
+}
+#endif
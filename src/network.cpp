@@ -0,0 +1,403 @@
+/*
+	@copydoc network.hpp
+*/
+
+#include "network.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+
+namespace
+{
+	//! @brief Maps a text file for sequential reading
+	//! @param file Path to the file
+	//! @param text Set to the start of the mapping, or NULL for an empty file
+	//! @param size Set to the length of the file
+	//! @retval true if successful, false otherwise
+	bool mapText(const char* file, void*& text, size_t& size)
+	{
+		int fd = open(file, O_RDONLY);
+		if (fd < 0)
+		{
+			std::cerr << "Could not open file: " << file << "\n";
+			return false;
+		}
+
+		struct stat info;
+		if (fstat(fd, &info) != 0)
+		{
+			std::cerr << "Could not read file: " << file << "\n";
+			close(fd);
+			return false;
+		}
+
+		size = info.st_size;
+		text = NULL;
+		if (size == 0)
+		{
+			close(fd);
+			return true;
+		}
+
+		text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (text == MAP_FAILED)
+		{
+			std::cerr << "Could not map file: " << file << "\n";
+			return false;
+		}
+		madvise(text, size, MADV_SEQUENTIAL);
+		return true;
+	}
+
+	//! @brief Reads the next whitespace separated integer on the current line
+	//! @param pos Current position. Moved past the integer.
+	//! @param end End of the text
+	//! @param value Set to the integer read
+	//! @retval false if the line ended before an integer was found
+	bool scanInt(const char*& pos, const char* end, int64_t& value)
+	{
+		while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r'))
+			++pos;
+
+		bool negative = (pos < end && *pos == '-');
+		if (negative)
+			++pos;
+		if (pos >= end || *pos < '0' || *pos > '9')
+			return false;
+
+		value = 0;
+		while (pos < end && *pos >= '0' && *pos <= '9')
+			value = (value * 10) + (*pos++ - '0');
+		if (negative)
+			value = -value;
+		return true;
+	}
+
+	//! @brief A line-aligned slice of a text graph file and the edges parsed from it
+	struct textChunk
+	{
+		const char* begin;			//! First character of the slice
+		const char* end;			//! One past the last character of the slice
+		int64_t lines;				//! Number of lines (vertices) in the slice
+		int64_t maxID;				//! Largest neighbor ID seen in the slice
+		std::vector<edge> edges;	//! Edges, numbered by line within the slice
+	};
+
+	//! @brief Parses one slice of a text adjacency list. Every line is a vertex, holding pairs of neighbor ID and
+	//!	 weight. Any character other than a digit or a sign separates numbers.
+	void parseChunk(textChunk* chunk)
+	{
+		const char* pos = chunk->begin;
+		const char* end = chunk->end;
+		int64_t line = 0;
+		chunk->maxID = -1;
+
+		while (pos < end)
+		{
+			int values = 0;
+			int64_t neighbor = 0;
+			while (pos < end && *pos != '\n')
+			{
+				bool negative = (*pos == '-') && (pos + 1 < end) && (pos[1] >= '0' && pos[1] <= '9');
+				if (!negative && (*pos < '0' || *pos > '9'))
+				{
+					++pos;
+					continue;
+				}
+
+				if (negative)
+					++pos;
+				int64_t value = 0;
+				while (pos < end && *pos >= '0' && *pos <= '9')
+					value = (value * 10) + (*pos++ - '0');
+				if (negative)
+					value = -value;
+
+				// Even positions are neighbor IDs, odd positions the weight of the edge to that neighbor
+				if (values % 2 == 0)
+					neighbor = value;
+				else
+				{
+					edge e;
+					e.from   = line;
+					e.to     = neighbor;
+					e.weight = value;
+					chunk->edges.push_back(e);
+					if (neighbor > chunk->maxID)
+						chunk->maxID = neighbor;
+				}
+				++values;
+			}
+			++line;
+			if (pos < end)
+				++pos; // Skip the newline
+		}
+		chunk->lines = line;
+	}
+}
+
+namespace NetworkFile
+{
+	const char MAGIC[8] = { 'I', 'S', 'E', 'G', 'N', 'E', 'T', '\0' };
+
+	Format detect(const char* file)
+	{
+		std::ifstream input(file, std::ios::binary);
+		if (!input)
+		{
+			std::cerr << "Could not open file: " << file << "\n";
+			return MISSING;
+		}
+
+		char magic[sizeof(MAGIC)] = { 0 };
+		input.read(magic, sizeof(magic));
+		if (memcmp(magic, MAGIC, sizeof(MAGIC)) == 0)
+			return BINARY;
+
+		// DIMACS files start with a comment or problem line, adjacency lists with a vertex ID
+		char leading = 0;
+		input.clear();
+		input.seekg(0);
+		input >> leading;
+		if (leading == 'c' || leading == 'p')
+			return DIMACS;
+		return TEXT;
+	}
+
+	bool parseText(const char* file, int threads, std::vector<edge>& edges, int64_t& nodes)
+	{
+		size_t size = 0;
+		void* text = NULL;
+		edges.clear();
+		nodes = 0;
+		if (!mapText(file, text, size))
+			return false;
+		if (size == 0)
+			return true;
+
+		// Small files are not worth the cost of starting threads. Give every thread at least a megabyte.
+		if (threads <= 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = std::max(1, std::min(threads, static_cast<int>(size >> 20) + 1));
+
+		// Split the file into slices that start and end on line boundaries
+		const char* begin = static_cast<const char*>(text);
+		const char* end   = begin + size;
+		std::vector<textChunk> chunks(threads);
+		const char* sliceStart = begin;
+		for (int i = 0; i < threads; ++i)
+		{
+			const char* sliceEnd = (i == threads - 1) ? end : begin + (size * (i + 1)) / threads;
+			if (sliceEnd < sliceStart)
+				sliceEnd = sliceStart;
+			while (sliceEnd < end && sliceEnd > begin && sliceEnd[-1] != '\n')
+				++sliceEnd;
+			chunks[i].begin = sliceStart;
+			chunks[i].end   = sliceEnd;
+			sliceStart = sliceEnd;
+		}
+
+		std::vector<std::thread> workers;
+		for (int i = 1; i < threads; ++i)
+			workers.push_back(std::thread(parseChunk, &chunks[i]));
+		parseChunk(&chunks[0]);
+		for (unsigned int i = 0; i < workers.size(); ++i)
+			workers[i].join();
+		munmap(text, size);
+
+		// Number the lines of each slice after the lines of the slices before it
+		int64_t lines = 0;
+		int64_t maxID = -1;
+		size_t totalEdges = 0;
+		for (int i = 0; i < threads; ++i)
+			totalEdges += chunks[i].edges.size();
+		edges.reserve(totalEdges);
+		for (int i = 0; i < threads; ++i)
+		{
+			std::vector<edge>& sliceEdges = chunks[i].edges;
+			for (size_t j = 0; j < sliceEdges.size(); ++j)
+			{
+				sliceEdges[j].from += lines;
+				edges.push_back(sliceEdges[j]);
+			}
+			std::vector<edge>().swap(sliceEdges);
+			lines += chunks[i].lines;
+			maxID = std::max(maxID, chunks[i].maxID);
+		}
+
+		nodes = std::max(lines, maxID + 1);
+		return true;
+	}
+
+	bool parseDimacs(const char* file, std::vector<edge>& edges, int64_t& nodes, int64_t& source, int64_t& sink)
+	{
+		size_t size = 0;
+		void* text = NULL;
+		edges.clear();
+		if (!mapText(file, text, size))
+			return false;
+
+		const char* pos = static_cast<const char*>(text);
+		const char* end = pos + size;
+		int64_t problemNodes = -1;
+		int64_t terminal[2] = { -1, -1 };
+		int lineNumber = 0;
+		bool valid = true;
+
+		while (valid && pos < end)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', end - pos));
+			if (!lineEnd)
+				lineEnd = end;
+			++lineNumber;
+
+			char descriptor = *pos++;
+			if (descriptor == 'a')
+			{
+				int64_t from, to, capacity;
+				valid = scanInt(pos, lineEnd, from) && scanInt(pos, lineEnd, to) && scanInt(pos, lineEnd, capacity)
+					&& from >= 1 && from <= problemNodes && to >= 1 && to <= problemNodes && capacity >= 0;
+				if (valid)
+				{
+					edge e;
+					e.from   = from - 1;
+					e.to     = to - 1;
+					e.weight = capacity;
+					edges.push_back(e);
+				}
+			}
+			else if (descriptor == 'n')
+			{
+				int64_t id;
+				valid = scanInt(pos, lineEnd, id) && id >= 1 && id <= problemNodes;
+				while (valid && pos < lineEnd && (*pos == ' ' || *pos == '\t'))
+					++pos;
+				// A second source or sink line is as invalid as an unknown terminal
+				int64_t& named = terminal[(pos < lineEnd && *pos == 's') ? 0 : 1];
+				valid = valid && pos < lineEnd && (*pos == 's' || *pos == 't') && named < 0;
+				if (valid)
+					named = id - 1;
+			}
+			else if (descriptor == 'p')
+			{
+				while (pos < lineEnd && (*pos == ' ' || *pos == '\t'))
+					++pos;
+				// Like a second source or sink, a second problem line is invalid
+				int64_t problemArcs;
+				valid = problemNodes < 0 && (lineEnd - pos > 3) && strncmp(pos, "max", 3) == 0;
+				pos += 3;
+				valid = valid && scanInt(pos, lineEnd, problemNodes) && scanInt(pos, lineEnd, problemArcs)
+					&& problemNodes > 0 && problemArcs >= 0;
+				if (valid)
+					edges.reserve(problemArcs);
+			}
+			else if (descriptor != 'c' && descriptor != '\n' && descriptor != '\r')
+				valid = false;
+
+			pos = (lineEnd < end) ? lineEnd + 1 : end;
+		}
+		if (text)
+			munmap(text, size);
+
+		if (!valid)
+		{
+			std::cerr << "Invalid DIMACS line " << lineNumber << " in file: " << file << "\n";
+			return false;
+		}
+		if (problemNodes < 0 || terminal[0] < 0 || terminal[1] < 0)
+		{
+			std::cerr << "DIMACS file is missing its problem line, source or sink: " << file << "\n";
+			return false;
+		}
+		if (terminal[0] == terminal[1])
+		{
+			std::cerr << "DIMACS source and sink are the same node: " << file << "\n";
+			return false;
+		}
+
+		nodes  = problemNodes;
+		source = terminal[0];
+		sink   = terminal[1];
+		return true;
+	}
+
+	bool mapBinary(const char* file, void*& data, size_t& size)
+	{
+		int fd = open(file, O_RDONLY);
+		if (fd < 0)
+		{
+			std::cerr << "Could not open file: " << file << "\n";
+			return false;
+		}
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(header))
+		{
+			std::cerr << "Not a binary network file: " << file << "\n";
+			close(fd);
+			return false;
+		}
+
+		// Private and writable, so the mapping can be handed out as the network arrays without touching the file
+		size = info.st_size;
+		data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+		{
+			std::cerr << "Could not map file: " << file << "\n";
+			return false;
+		}
+
+		const header* h = static_cast<const header*>(data);
+		if (memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->version != VERSION || h->nodes < 0 || h->arcs < 0
+			|| h->capacityBytes == 0 || h->capacityBytes > 8 || h->indexBytes == 0 || h->indexBytes > 8)
+		{
+			std::cerr << "Unsupported binary network file: " << file << "\n";
+			munmap(data, size);
+			return false;
+		}
+
+		// Each vertex and arc takes at least one byte, which also keeps the array sizes from overflowing
+		bool truncated = static_cast<uint64_t>(h->nodes) >= size || static_cast<uint64_t>(h->arcs) >= size;
+		if (!truncated)
+		{
+			size_t firstBytes = aligned(static_cast<size_t>(h->indexBytes) * (h->nodes + 1));
+			size_t arcBytes   = aligned(static_cast<size_t>(h->indexBytes) * h->arcs);
+			size_t capBytes   = aligned(static_cast<size_t>(h->capacityBytes) * h->arcs);
+			truncated = size < aligned(sizeof(header)) + firstBytes + (2 * arcBytes) + capBytes;
+		}
+		if (truncated)
+		{
+			std::cerr << "Truncated binary network file: " << file << "\n";
+			munmap(data, size);
+			return false;
+		}
+		return true;
+	}
+
+	bool readHeader(const char* file, header& h)
+	{
+		std::ifstream input(file, std::ios::binary);
+		if (!input)
+		{
+			std::cerr << "Could not open file: " << file << "\n";
+			return false;
+		}
+
+		input.read(reinterpret_cast<char*>(&h), sizeof(h));
+		if (!input || memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.version != VERSION)
+		{
+			std::cerr << "Unsupported binary network file: " << file << "\n";
+			return false;
+		}
+		return true;
+	}
+
+	void unmap(void* data, size_t size)
+	{
+		munmap(data, size);
+	}
+}
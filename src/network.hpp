@@ -0,0 +1,593 @@
+/*
+	@brief Flat residual network in compressed sparse row (CSR) form, with fast text and binary loaders.
+	@author Drew Guarnera, Bharath Bogadamidi, Heather Michaud
+	@version 0.9
+	@copyright Copyright 2014 Guarnera, Bogadamidi, Michaud. All rights reserved.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+//! @brief A directed, weighted edge as read from a graph file, before it is narrowed to a network's types
+struct edge
+{
+	int64_t from;	//! ID of the vertex the edge leaves
+	int64_t to;		//! ID of the vertex the edge enters
+	int64_t weight;	//! The capacity or weight of the edge
+};
+
+//! @brief Parsing and mapping of graph files, shared by every FlowNetwork instantiation
+namespace NetworkFile
+{
+	//! @brief The kinds of graph file that FlowNetwork::load understands
+	enum Format { MISSING, TEXT, DIMACS, BINARY };
+
+	extern const char MAGIC[8];		//!< First bytes of a binary network file
+	const uint32_t VERSION = 1;		//!< Binary network format version
+
+	//! @brief Fixed size header at the start of a binary network file. Each array that follows starts on an 8 byte
+	//!	 boundary, in the order: first (nodes + 1), head (arcs), rev (arcs), base (arcs).
+	struct header
+	{
+		char magic[8];				//! Always MAGIC
+		uint32_t version;			//! Format version, VERSION
+		uint32_t capacityBytes;		//! Size of one capacity value
+		uint32_t indexBytes;		//! Size of one vertex or arc index
+		uint32_t capacityIsFloat;	//! Non-zero if capacities are floating point
+		int64_t nodes;				//! Number of vertices
+		int64_t arcs;				//! Number of arcs, including reverse arcs
+		int64_t source;				//! Source vertex
+		int64_t sink;				//! Sink vertex
+	};
+
+	//! @brief Rounds a byte count up to the array alignment used in binary network files
+	inline size_t aligned(size_t bytes)
+	{
+		return (bytes + 7) & ~static_cast<size_t>(7);
+	}
+
+	//! @brief Determines the kind of a graph file from its first bytes
+	//! @param file Path to the graph file
+	//! @retval The format of the file, or MISSING if it could not be opened
+	Format detect(const char* file);
+
+	//! @brief Parses a text adjacency list (see Tools::graphFromFile for the format). The file is memory mapped and
+	//!	 split into line-aligned chunks that are parsed in parallel.
+	//! @param file Path to the text graph file
+	//! @param threads Number of parser threads, or 0 to use one per hardware core
+	//! @param edges Filled with the edges of the graph, numbered by line
+	//! @param nodes Set to the number of vertices: the number of lines or the largest neighbor ID + 1
+	//! @retval true if successful, false otherwise
+	bool parseText(const char* file, int threads, std::vector<edge>& edges, int64_t& nodes);
+
+	//! @brief Parses a DIMACS max-flow problem ("p max", "n <id> s|t" and "a <from> <to> <capacity>" lines). DIMACS
+	//!	 vertices are numbered from 1 and are returned numbered from 0.
+	//! @param file Path to the DIMACS file
+	//! @param edges Filled with the arcs of the problem
+	//! @param nodes Set to the number of vertices from the problem line
+	//! @param source Set to the source vertex
+	//! @param sink Set to the sink vertex
+	//! @retval true if successful, false otherwise
+	bool parseDimacs(const char* file, std::vector<edge>& edges, int64_t& nodes, int64_t& source, int64_t& sink);
+
+	//! @brief Maps a binary network file privately (copy on write) and checks its header and length
+	//! @param file Path to the binary network file
+	//! @param data Set to the start of the mapping
+	//! @param size Set to the length of the mapping
+	//! @retval true if successful, false otherwise
+	bool mapBinary(const char* file, void*& data, size_t& size);
+
+	//! @brief Reads the header of a binary network file, to find the types it was written with
+	//! @param file Path to the binary network file
+	//! @param h Filled with the header
+	//! @retval true if successful, false if the file could not be read or is not a binary network
+	bool readHeader(const char* file, header& h);
+
+	//! @brief Releases a mapping made by mapBinary
+	void unmap(void* data, size_t size);
+
+	//! @brief Whether a capacity type is stored as floating point in binary files
+	template<typename Cap> inline uint32_t isFloat()
+	{
+		return std::numeric_limits<Cap>::is_integer ? 0 : 1;
+	}
+}
+
+//! @brief Residual network stored as flat arrays. Every edge u -> v is stored as an arc at u paired with a reverse arc
+//!	 at v, so that augmenting a path only touches two array slots per edge.
+/*
+	@note The arcs of vertex u are head[first[u]] .. head[first[u + 1] - 1]. rev[a] is the index of the arc paired with
+	 arc a. base[a] holds the original capacity and cap[a] the residual capacity, so the flow on an arc whose reverse
+	 has no capacity of its own is base[a] - cap[a].
+	@note Cap is the capacity type (int16_t, int32_t, int64_t or float) and Index the signed type used for vertex and
+	 arc numbers (int32_t or int64_t). Narrow types halve the size of the arrays; the builders refuse inputs that would
+	 overflow them.
+*/
+template<typename Cap, typename Index>
+class FlowNetwork
+{
+	public:
+		typedef Cap capacity_type;	//!< Capacity type
+		typedef Index index_type;	//!< Vertex and arc number type
+
+		//! @brief Basic constructor
+		FlowNetwork() : numNodes(0), numArcs(0), source(0), sink(0), first(NULL), head(NULL), rev(NULL), base(NULL),
+			cap(NULL), mapped(NULL), mappedSize(0)
+		{
+		}
+
+		//! @brief Basic destructor. Releases the file mapping, if any.
+		~FlowNetwork()
+		{
+			clear();
+		}
+
+		//! @brief Loads a network from a file, detecting whether it is a binary network, a DIMACS problem or a text
+		//!	 adjacency list
+		//! @param file Path to the graph file
+		//! @retval true if successful, false otherwise
+		bool load(const char* file)
+		{
+			switch (NetworkFile::detect(file))
+			{
+				case NetworkFile::BINARY: return fromBinary(file);
+				case NetworkFile::DIMACS: return fromDimacs(file);
+				case NetworkFile::TEXT:   return fromFile(file);
+				default:                  return false;
+			}
+		}
+
+		//! @brief Parses a text adjacency list (see NetworkFile::parseText)
+		//! @param file Path to the text graph file
+		//! @param threads Number of parser threads, or 0 to use one per hardware core
+		//! @retval true if successful, false otherwise
+		bool fromFile(const char* file, int threads = 0)
+		{
+			clear();
+			std::vector<edge> edges;
+			int64_t nodeCount = 0;
+			if (!NetworkFile::parseText(file, threads, edges, nodeCount))
+				return false;
+			return build(nodeCount, edges);
+		}
+
+		//! @brief Parses a DIMACS max-flow problem (see NetworkFile::parseDimacs). Parallel arcs are merged by adding
+		//!	 their capacities.
+		//! @param file Path to the DIMACS file
+		//! @retval true if successful, false otherwise
+		bool fromDimacs(const char* file)
+		{
+			clear();
+			std::vector<edge> edges;
+			int64_t nodeCount = 0, dimacsSource = 0, dimacsSink = 0;
+			if (!NetworkFile::parseDimacs(file, edges, nodeCount, dimacsSource, dimacsSink))
+				return false;
+			if (!build(nodeCount, edges, true))
+				return false;
+			source = dimacsSource;
+			sink   = dimacsSink;
+			return true;
+		}
+
+		//! @brief Maps a binary network written by writeBinary. The topology and original capacities are used in
+		//!	 place from the mapping; only the residual capacities are copied.
+		//! @param file Path to the binary network file
+		//! @retval true if successful, false otherwise
+		bool fromBinary(const char* file)
+		{
+			clear();
+			void* data = NULL;
+			size_t size = 0;
+			if (!NetworkFile::mapBinary(file, data, size))
+				return false;
+
+			const NetworkFile::header* h = static_cast<const NetworkFile::header*>(data);
+			if (h->capacityBytes != sizeof(Cap) || h->capacityIsFloat != NetworkFile::isFloat<Cap>()
+				|| h->indexBytes != sizeof(Index))
+			{
+				std::cerr << "Binary network has " << (h->capacityIsFloat ? "floating point" : "integer")
+					<< " capacities of " << h->capacityBytes << " byte(s) and indices of " << h->indexBytes
+					<< " byte(s), which do not match this network: " << file << "\n";
+				NetworkFile::unmap(data, size);
+				return false;
+			}
+			if (!fits<Index>(h->nodes + 1, "vertex count") || !fits<Index>(h->arcs, "arc count"))
+			{
+				NetworkFile::unmap(data, size);
+				return false;
+			}
+
+			mapped     = data;
+			mappedSize = size;
+			numNodes   = h->nodes;
+			numArcs    = h->arcs;
+			source     = h->source;
+			sink       = h->sink;
+
+			size_t firstBytes = NetworkFile::aligned(sizeof(Index) * (numNodes + 1));
+			size_t arcBytes   = NetworkFile::aligned(sizeof(Index) * numArcs);
+			char* arrays = static_cast<char*>(data) + NetworkFile::aligned(sizeof(NetworkFile::header));
+			first = reinterpret_cast<Index*>(arrays);
+			head  = reinterpret_cast<Index*>(arrays + firstBytes);
+			rev   = reinterpret_cast<Index*>(arrays + firstBytes + arcBytes);
+			base  = reinterpret_cast<Cap*>(arrays + firstBytes + (2 * arcBytes));
+
+			// Every solver indexes the arrays by each other's values without checking them, so check them once here
+			if (h->source < 0 || h->source >= h->nodes || h->sink < 0 || h->sink >= h->nodes || h->source == h->sink
+				|| !consistent())
+			{
+				std::cerr << "Corrupt binary network file: " << file << "\n";
+				clear();
+				return false;
+			}
+
+			// The residual capacities are the only array that is written to while solving
+			capStore.assign(base, base + numArcs);
+			cap = capStore.empty() ? NULL : &capStore[0];
+			return true;
+		}
+
+		//! @brief Writes the network in the versioned binary format
+		//! @param file Path to the file that will be written to
+		//! @retval true if successful, false otherwise
+		bool writeBinary(const char* file) const
+		{
+			std::ofstream output(file, std::ios::binary);
+			if (!output)
+			{
+				std::cerr << "Could not open file: " << file << "\n";
+				return false;
+			}
+
+			NetworkFile::header h;
+			memset(&h, 0, sizeof(h));
+			memcpy(h.magic, NetworkFile::MAGIC, sizeof(h.magic));
+			h.version         = NetworkFile::VERSION;
+			h.capacityBytes   = sizeof(Cap);
+			h.indexBytes      = sizeof(Index);
+			h.capacityIsFloat = NetworkFile::isFloat<Cap>();
+			h.nodes           = numNodes;
+			h.arcs            = numArcs;
+			h.source          = source;
+			h.sink            = sink;
+
+			output.write(reinterpret_cast<const char*>(&h), sizeof(h));
+			pad(output, sizeof(h));
+
+			std::vector<Index> noOffsets(1, 0);
+			const Index* offsets = first ? first : &noOffsets[0];
+			writeArray(output, offsets, static_cast<size_t>(numNodes) + 1);
+			writeArray(output, head, numArcs);
+			writeArray(output, rev, numArcs);
+			writeArray(output, base, numArcs);
+
+			output.close();
+			return !output.fail();
+		}
+
+		//! @brief Builds the network from a list of edges. Every edge becomes an arc at its source paired with a
+		//!	 reverse arc at its target, and the arcs of each vertex are sorted by head.
+		//! @param nodeCount Number of vertices. Grown if an edge refers to a larger vertex ID.
+		//! @param edges The edges of the graph. Consumed (reordered) by this call.
+		//! @param sumDuplicates If true, the weights of duplicate edges are added. Otherwise the first weight is kept.
+		//! @retval true if successful, false if the graph does not fit this network's types
+		bool build(int64_t nodeCount, std::vector<edge>& edges, bool sumDuplicates = false)
+		{
+			clear();
+
+			// Drop edges with invalid IDs and make room for every vertex that is referenced
+			std::vector<edge>::iterator valid = edges.begin();
+			for (std::vector<edge>::iterator e = edges.begin(); e != edges.end(); ++e)
+			{
+				if (e->from < 0 || e->to < 0)
+					continue;
+				nodeCount = std::max(nodeCount, std::max(e->from, e->to) + 1);
+				*valid++ = *e;
+			}
+			edges.erase(valid, edges.end());
+
+			// Group the edges by source vertex (counting sort, stable), then sort each group by target and merge
+			// duplicates
+			if (!fits<Index>(nodeCount + 1, "vertex count"))
+				return false;
+			std::vector<int64_t> offset(nodeCount + 1, 0);
+			for (size_t i = 0; i < edges.size(); ++i)
+				++offset[edges[i].from + 1];
+			for (int64_t u = 0; u < nodeCount; ++u)
+				offset[u + 1] += offset[u];
+
+			std::vector<edge> grouped(edges.size());
+			{
+				std::vector<int64_t> fill(offset.begin(), offset.end() - 1);
+				for (size_t i = 0; i < edges.size(); ++i)
+					grouped[fill[edges[i].from]++] = edges[i];
+			}
+			std::vector<edge>().swap(edges);
+
+			std::vector<edge>::iterator unique = grouped.begin();
+			for (int64_t u = 0; u < nodeCount; ++u)
+			{
+				std::vector<edge>::iterator groupBegin = grouped.begin() + offset[u];
+				std::vector<edge>::iterator groupEnd   = grouped.begin() + offset[u + 1];
+				std::stable_sort(groupBegin, groupEnd, edgeByTarget);
+				for (std::vector<edge>::iterator e = groupBegin; e != groupEnd; ++e)
+				{
+					if (e == groupBegin || e->to != (e - 1)->to)
+						*unique++ = *e;
+					else if (sumDuplicates)
+						(unique - 1)->weight += e->weight;
+				}
+			}
+			grouped.erase(unique, grouped.end());
+
+			if (!fits<Index>(2 * static_cast<int64_t>(grouped.size()), "arc count"))
+				return false;
+			for (size_t i = 0; i < grouped.size(); ++i)
+				if (!fits<Cap>(grouped[i].weight, "capacity"))
+					return false;
+
+			allocate(nodeCount, 2 * grouped.size());
+			std::fill(first, first + numNodes + 1, 0);
+			for (size_t i = 0; i < grouped.size(); ++i)
+			{
+				++first[grouped[i].from + 1];
+				++first[grouped[i].to + 1];
+			}
+			for (Index u = 0; u < numNodes; ++u)
+				first[u + 1] += first[u];
+
+			std::vector<Index> arcHead(numArcs), partner(numArcs);
+			std::vector<Cap> arcBase(numArcs);
+			{
+				std::vector<Index> fill(first, first + numNodes);
+				for (size_t i = 0; i < grouped.size(); ++i)
+				{
+					Index forward = fill[grouped[i].from]++;
+					Index reverse = fill[grouped[i].to]++;
+					arcHead[forward] = grouped[i].to;
+					arcBase[forward] = static_cast<Cap>(grouped[i].weight);
+					arcHead[reverse] = grouped[i].from;
+					arcBase[reverse] = 0;
+					partner[forward] = reverse;
+					partner[reverse] = forward;
+				}
+			}
+			std::vector<edge>().swap(grouped);
+
+			// Sort the arcs of each vertex by head so traversal order matches the adjacency list Graph
+			std::vector<Index> order(numArcs);
+			for (Index a = 0; a < numArcs; ++a)
+				order[a] = a;
+			arcOrder byHead(arcHead, arcBase);
+			for (Index u = 0; u < numNodes; ++u)
+				std::sort(order.begin() + first[u], order.begin() + first[u + 1], byHead);
+
+			std::vector<Index> position(numArcs);
+			for (Index a = 0; a < numArcs; ++a)
+				position[order[a]] = a;
+
+			for (Index a = 0; a < numArcs; ++a)
+			{
+				head[a] = arcHead[order[a]];
+				base[a] = arcBase[order[a]];
+				rev[a]  = position[partner[order[a]]];
+			}
+			reset();
+
+			source = 0;
+			sink   = numNodes > 0 ? numNodes - 1 : 0;
+			return true;
+		}
+
+		//! @brief Sizes the owned arrays for a network built in place by the caller, who fills first, head, rev and
+		//!	 base. Storage from earlier builds is reused when it is large enough.
+		//! @param nodeCount Number of vertices
+		//! @param arcCount Number of arcs, including reverse arcs
+		void allocate(Index nodeCount, Index arcCount)
+		{
+			releaseMapping();
+			numNodes = nodeCount;
+			numArcs  = arcCount;
+			firstStore.resize(static_cast<size_t>(numNodes) + 1);
+			headStore.resize(numArcs);
+			revStore.resize(numArcs);
+			baseStore.resize(numArcs);
+			capStore.resize(numArcs);
+			first = &firstStore[0];
+			head  = headStore.empty() ? NULL : &headStore[0];
+			rev   = revStore.empty()  ? NULL : &revStore[0];
+			base  = baseStore.empty() ? NULL : &baseStore[0];
+			cap   = capStore.empty()  ? NULL : &capStore[0];
+		}
+
+		//! @brief Copies another network, converting its capacities and indices to this network's types
+		//! @param other The network to copy, including its residual capacities
+		//! @retval true if successful, false if a value does not fit this network's types
+		template<typename OtherCap, typename OtherIndex>
+		bool assign(const FlowNetwork<OtherCap, OtherIndex>& other)
+		{
+			clear();
+			if (!fits<Index>(static_cast<int64_t>(other.numNodes) + 1, "vertex count")
+				|| !fits<Index>(other.numArcs, "arc count"))
+				return false;
+			for (OtherIndex a = 0; a < other.numArcs; ++a)
+				if (!fits<Cap>(other.base[a], "capacity") || !fits<Cap>(other.cap[a], "capacity"))
+					return false;
+
+			allocate(other.numNodes, other.numArcs);
+			std::copy(other.first, other.first + other.numNodes + 1, first);
+			std::copy(other.head, other.head + other.numArcs, head);
+			std::copy(other.rev, other.rev + other.numArcs, rev);
+			std::copy(other.base, other.base + other.numArcs, base);
+			std::copy(other.cap, other.cap + other.numArcs, cap);
+			source = other.source;
+			sink   = other.sink;
+			return true;
+		}
+
+		//! @brief Restores every residual capacity to its original capacity
+		void reset()
+		{
+			if (numArcs > 0)
+				std::copy(base, base + numArcs, cap);
+		}
+
+		//! @brief Get the number of nodes contained within this network
+		//! @retval The number of vertices
+		Index nodes() const
+		{
+			return numNodes;
+		}
+
+		//! @brief Get the number of arcs, including reverse arcs
+		//! @retval The number of arcs
+		Index arcs() const
+		{
+			return numArcs;
+		}
+
+		//! @brief Prints the network out in adjacency list format, showing residual capacities
+		void print() const
+		{
+			for (Index u = 0; u < numNodes; ++u)
+			{
+				// Current vertex
+				std::cout << u;
+
+				// Neighboring vertices reachable in the residual network
+				for (Index a = first[u]; a < first[u + 1]; ++a)
+					if (cap[a] > 0)
+						std::cout << " --(" << cap[a] << ")--> " << head[a];
+				std::cout << std::endl;
+			}
+		}
+
+		Index numNodes;		//!< Number of vertices
+		Index numArcs;		//!< Number of arcs, including reverse arcs
+		Index source;		//!< Source vertex. Defaults to the first vertex.
+		Index sink;			//!< Sink vertex. Defaults to the last vertex.
+		Index* first;		//!< Offset of the first arc of each vertex, numNodes + 1 entries
+		Index* head;		//!< Vertex each arc enters
+		Index* rev;			//!< Index of the paired reverse arc
+		Cap* base;			//!< Original capacity of each arc
+		Cap* cap;			//!< Residual capacity of each arc
+
+	private:
+		//! @brief Orders the arcs of one vertex by head, original arcs before reverse arcs of the same head
+		struct arcOrder
+		{
+			const std::vector<Index>& arcHead;
+			const std::vector<Cap>& arcBase;
+
+			arcOrder(const std::vector<Index>& h, const std::vector<Cap>& b) : arcHead(h), arcBase(b) {}
+
+			bool operator()(Index a, Index b) const
+			{
+				if (arcHead[a] != arcHead[b])
+					return arcHead[a] < arcHead[b];
+				if (arcBase[a] != arcBase[b])
+					return arcBase[a] > arcBase[b];
+				return a < b;
+			}
+		};
+
+		//! @brief Orders edges by destination, keeping the input order of duplicates
+		static bool edgeByTarget(const edge& a, const edge& b)
+		{
+			return a.to < b.to;
+		}
+
+		//! @brief Checks that a value can be held by one of this network's types
+		//! @param value The value to check
+		//! @param what Description of the value for the error message
+		//! @retval true if the value fits, false otherwise
+		template<typename T, typename V> static bool fits(V value, const char* what)
+		{
+			if (static_cast<double>(value) > static_cast<double>(std::numeric_limits<T>::max())
+				|| static_cast<double>(value) < -static_cast<double>(std::numeric_limits<T>::max()))
+			{
+				std::cerr << "The " << what << " " << value << " does not fit in " << sizeof(T) << " byte(s)\n";
+				return false;
+			}
+			return true;
+		}
+
+		//! @brief Checks that the arrays describe a network: the arcs of each vertex follow those of the one before,
+		//!	 every head is a vertex, and the reverse of each arc u -> v is another arc v -> u paired back with it
+		//! @retval true if the arrays are consistent, false otherwise
+		bool consistent() const
+		{
+			if (first[0] != 0 || first[numNodes] != numArcs)
+				return false;
+			for (Index u = 0; u < numNodes; ++u)
+				if (first[u] > first[u + 1])
+					return false;
+			for (Index u = 0; u < numNodes; ++u)
+			{
+				for (Index a = first[u]; a < first[u + 1]; ++a)
+				{
+					if (head[a] < 0 || head[a] >= numNodes || rev[a] < first[head[a]] || rev[a] >= first[head[a] + 1]
+						|| rev[a] == a || rev[rev[a]] != a || head[rev[a]] != u)
+						return false;
+				}
+			}
+			return true;
+		}
+
+		//! @brief Writes zeros up to the next array boundary
+		static void pad(std::ofstream& output, size_t bytes)
+		{
+			static const char padding[8] = { 0 };
+			output.write(padding, NetworkFile::aligned(bytes) - bytes);
+		}
+
+		//! @brief Writes one array followed by its padding
+		template<typename T> static void writeArray(std::ofstream& output, const T* values, size_t count)
+		{
+			if (count > 0)
+				output.write(reinterpret_cast<const char*>(values), sizeof(T) * count);
+			pad(output, sizeof(T) * count);
+		}
+
+		//! @brief Releases the file mapping, if any, leaving owned storage allocated
+		void releaseMapping()
+		{
+			if (mapped)
+				NetworkFile::unmap(mapped, mappedSize);
+			mapped = NULL;
+			mappedSize = 0;
+		}
+
+		//! @brief Releases owned storage and any file mapping
+		void clear()
+		{
+			releaseMapping();
+			firstStore.clear();
+			headStore.clear();
+			revStore.clear();
+			baseStore.clear();
+			capStore.clear();
+			numNodes = numArcs = source = sink = 0;
+			first = head = rev = NULL;
+			base = cap = NULL;
+		}
+
+		std::vector<Index> firstStore;	//!< Owned offsets, when not mapped
+		std::vector<Index> headStore;	//!< Owned arc heads, when not mapped
+		std::vector<Index> revStore;	//!< Owned reverse arc indices, when not mapped
+		std::vector<Cap> baseStore;		//!< Owned original capacities, when not mapped
+		std::vector<Cap> capStore;		//!< Residual capacities. Always owned.
+		void* mapped;					//!< Start of the binary file mapping, or NULL
+		size_t mappedSize;				//!< Length of the binary file mapping
+
+		FlowNetwork(const FlowNetwork&);
+		FlowNetwork& operator=(const FlowNetwork&);
+};
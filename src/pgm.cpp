@@ -3,6 +3,7 @@
 */
 
 #include "pgm.hpp"
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <sstream>
@@ -10,148 +11,301 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-Pgm::Pgm() : xMax(0), yMax(0), pixMax(0), threshold(0) 
+Pgm::Pgm() : matrix(NULL), xMax(0), yMax(0), pixMax(0), threshold(0), layout(RASTER), weight(WeightTable::LINEAR),
+	sigma(0), threads(0), xCapacity(0), yCapacity(0)
 {
 }
 
 Pgm::~Pgm() 
 {
-	for( int index = 0 ; index < xMax ; index++ )
+	for( int index = 0 ; index < xCapacity ; index++ )
 	{
 	    delete [] matrix[index] ;   
 	}
 	delete [] matrix ;
 }
 
-bool Pgm::fromFile(const char* file)
+void Pgm::reserve(int width, int height)
 {
-	std::ifstream input;
-	input.open(file);
-	if (!input)
-	{
-		std::cerr << "Could not open file: " << file << "\n";
-		return false;
-	}
+	if (width <= xCapacity && height <= yCapacity)
+		return;
 
-	std::string line;
-	getline(input, line);	// "P2"
-	getline(input, line);	// "#Created by Irfan View"
+	for (int index = 0; index < xCapacity; index++)
+		delete [] matrix[index];
+	delete [] matrix;
 
-	std::stringstream ss;
-	ss << input.rdbuf();
-	ss >> xMax >> yMax;		// X, Y
-	ss >> pixMax;			// Max
+	xCapacity = std::max(width, xCapacity);
+	yCapacity = std::max(height, yCapacity);
+	matrix = new int *[xCapacity];
+	for (int index = 0; index < xCapacity; index++)
+		matrix[index] = new int[yCapacity];
+}
+
+bool Pgm::fromFile(const char* file)
+{
+	PgmReader reader;
+	return reader.open(file) && fromReader(reader);
+}
 
-	matrix = new int *[xMax]; 
-	for (int index = 0; index < xMax; index++)
-	    matrix[index] = new int[yMax];
+bool Pgm::fromReader(PgmReader& reader)
+{
+	xMax = reader.xMax;
+	yMax = reader.yMax;
+	pixMax = reader.pixMax;
+	reserve(xMax, yMax);
 
+	std::vector<int> row;
 	for (int yPos = 0; yPos < yMax; ++yPos)
+	{
+		if (!reader.readRow(row))
+		{
+			std::cerr << "Image ended early: " << reader.name << "\n";
+			return false;
+		}
 		for (int xPos = 0; xPos < xMax; ++xPos)
-			ss >> matrix[xPos][yPos];
-	input.close();
+			matrix[xPos][yPos] = std::min(std::max(row[xPos], 0), pixMax);
+	}
+	return true;
+}
 
+bool Pgm::fromPixels(const void* pixels, int width, int height, size_t stride, int depth)
+{
+	if (!pixels || width <= 0 || height <= 0 || depth < 1 || depth > 16)
+	{
+		std::cerr << "Unsupported image: " << width << "x" << height << ", " << depth << " bit(s) per pixel\n";
+		return false;
+	}
+
+	xMax = width;
+	yMax = height;
+	pixMax = (1 << depth) - 1;
+	reserve(xMax, yMax);
+
+	const unsigned char* row = static_cast<const unsigned char*>(pixels);
+	for (int yPos = 0; yPos < yMax; ++yPos, row += stride)
+	{
+		// Bits above the depth would fall outside the weight tables
+		if (depth <= 8)
+			for (int xPos = 0; xPos < xMax; ++xPos)
+				matrix[xPos][yPos] = std::min<int>(row[xPos], pixMax);
+		else
+			for (int xPos = 0; xPos < xMax; ++xPos)
+				matrix[xPos][yPos] = std::min<int>(reinterpret_cast<const unsigned short*>(row)[xPos], pixMax);
+	}
 	return true;
 }
 
-int Pgm::calculateThreshold()
+void WeightTable::build(Function function, int pixMax, int threshold, double sigma)
 {
-	long int nodeSum = 0;
-	for (int xPos = 0; xPos < xMax; ++xPos)
-		for (int yPos = 0; yPos < yMax; ++yPos)
-			nodeSum += matrix[xPos][yPos];
-	
-	threshold = std::abs( pixMax - (nodeSum / (xMax * yMax)) );
-	return threshold;
+	if (sigma <= 0)
+		sigma = pixMax / 8.0;
+
+	links.resize(pixMax + 1);
+	sources.resize(pixMax + 1);
+	sinks.resize(pixMax + 1);
+	for (int value = 0; value <= pixMax; ++value)
+	{
+		int link = pixMax - value;
+		if (function == GAUSSIAN)
+			link = static_cast<int>((pixMax * exp(-(static_cast<double>(value) * value) / (2 * sigma * sigma))) + 0.5);
+
+		links[value]   = (link > threshold) ? link : 0;
+		sources[value] = ((pixMax - value) > threshold) ? (pixMax - value) : 0;
+		sinks[value]   = (value > threshold) ? value : 0;
+	}
 }
 
-void Pgm::addPaths()
+int Pgm::findComponents(std::vector<int32_t>& start, std::vector<int32_t>& pixels)
 {
-	for (int xPos = 0; xPos < xMax; ++xPos)
+	weights.build(weight, pixMax, threshold, sigma);
+	int32_t numPixels = xMax * yMax;
+
+	// Label each component by a breadth first search over the kept n-links, in raster order
+	std::vector<int32_t> label(numPixels, -1);
+	std::vector<int32_t> queue;
+	queue.reserve(numPixels);
+	start.clear();
+	for (int32_t seed = 0; seed < numPixels; ++seed)
 	{
-		for (int yPos = 0; yPos < yMax; ++yPos)
-		{
-			int currentID = (xMax * yPos) + xPos;
-			g.addNode(currentID);
+		if (label[seed] >= 0)
+			continue;
 
-			if (xPos > 0)		// [xPos - 1][yPos] - Left
-			{
-				int weight = std::abs( pixMax - std::abs( matrix[xPos - 1][yPos] - matrix[xPos][yPos]) );
-				if (weight > threshold)
-				{
-					vertex lNeighbor; 
-					lNeighbor.id 	 = (xMax * yPos) + (xPos - 1);
-					lNeighbor.weight = weight;
-					g.addNeighbor(currentID, lNeighbor);
-				}
-			}
-			if (xPos < (xMax - 1))	// [xPos + 1][yPos] - Right
-			{
-				int weight = std::abs( pixMax - std::abs( matrix[xPos + 1][yPos] - matrix[xPos][yPos]) );
-				if (weight > threshold)
-				{
-					vertex rNeighbor;
-					rNeighbor.id 	 = (xMax * yPos) + (xPos + 1) ;
-					rNeighbor.weight = weight;
-					g.addNeighbor(currentID, rNeighbor);
-				}
-			}
-			if (yPos > 0)		// [xPos][yPos - 1] - Top
-			{
-				int weight = std::abs( pixMax - std::abs( matrix[xPos][yPos - 1] - matrix[xPos][yPos]) );
-				if (weight > threshold)
-				{
-					vertex tNeighbor; 	
-					tNeighbor.id 	 = (xMax * (yPos - 1) + xPos);
-					tNeighbor.weight = weight;
-					g.addNeighbor(currentID, tNeighbor);
-				}
-			}
-			if (yPos < (yMax - 1))	// [xPos][yPos + 1] - Bottom
+		int32_t component = start.size();
+		start.push_back(0);
+		queue.assign(1, seed);
+		label[seed] = component;
+		for (size_t next = 0; next < queue.size(); ++next)
+		{
+			int xPos = queue[next] % xMax;
+			int yPos = queue[next] / xMax;
+			int neighbors[4][2] = { { xPos - 1, yPos }, { xPos + 1, yPos }, { xPos, yPos - 1 }, { xPos, yPos + 1 } };
+			for (int i = 0; i < 4; ++i)
 			{
-				int weight = std::abs( pixMax - std::abs( matrix[xPos][yPos + 1] - matrix[xPos][yPos]) );
-				if (weight > threshold)
+				int xNext = neighbors[i][0];
+				int yNext = neighbors[i][1];
+				if (xNext < 0 || xNext >= xMax || yNext < 0 || yNext >= yMax)
+					continue;
+				int32_t index = (xMax * yNext) + xNext;
+				if (label[index] < 0 && weights.link(matrix[xNext][yNext], matrix[xPos][yPos]) > 0)
 				{
-					vertex bNeighbor;
-					bNeighbor.id 	 = (xMax * (yPos + 1) + xPos);
-					bNeighbor.weight = weight;
-					g.addNeighbor(currentID, bNeighbor);
+					label[index] = component;
+					queue.push_back(index);
 				}
 			}
 		}
+		start[component] = queue.size();
 	}
+
+	// Turn the sizes into positions, then place the pixels component by component, taking them in node order
+	int32_t components = start.size();
+	int32_t position = 0;
+	for (int32_t component = 0; component < components; ++component)
+	{
+		int32_t size = start[component];
+		start[component] = position;
+		position += size;
+	}
+	start.push_back(numPixels);
+
+	std::vector<int32_t>& byNode = queue;
+	byNode.resize(numPixels);
+	for (int yPos = 0; yPos < yMax; ++yPos)
+		for (int xPos = 0; xPos < xMax; ++xPos)
+			byNode[nodeID(xPos, yPos)] = (xMax * yPos) + xPos;
+
+	std::vector<int32_t> next(start.begin(), start.end() - 1);
+	pixels.resize(numPixels);
+	for (int32_t node = 0; node < numPixels; ++node)
+		pixels[next[label[byNode[node]]]++] = byNode[node];
+	return components;
 }
 
-void Pgm::addSuperNodes(int sourceID, int sinkID)
+int32_t Pgm::findRegions(int tolerance, flatRegions& regions)
 {
-	g.addNode(sourceID);
-	g.addNode(sinkID);
-	for (int xPos = 0; xPos < xMax; ++xPos)
+	weights.build(weight, pixMax, threshold, sigma);
+	int32_t numPixels = xMax * yMax;
+
+	// Grow each region by a breadth first search from its first pixel, in raster order, adding up the t-links
+	std::vector<int32_t>& label = regions.label;
+	label.assign(numPixels, -1);
+	regions.source.clear();
+	regions.sink.clear();
+	std::vector<int32_t> queue;
+	for (int32_t seed = 0; seed < numPixels; ++seed)
 	{
-		for (int yPos = 0; yPos < yMax; ++yPos)
+		if (label[seed] >= 0)
+			continue;
+
+		int32_t region = regions.count();
+		int seedValue = matrix[seed % xMax][seed / xMax];
+		int64_t source = 0, sink = 0;
+		queue.assign(1, seed);
+		label[seed] = region;
+		for (size_t next = 0; next < queue.size(); ++next)
 		{
-			if (std::abs( pixMax - matrix[xPos][yPos]) > threshold)
-			{	
-				vertex fromS;
-				fromS.id = (xMax * yPos) + xPos;
-				fromS.weight = std::abs( pixMax - matrix[xPos][yPos]);
-				g.addNeighbor(sourceID, fromS);
+			int xPos = queue[next] % xMax;
+			int yPos = queue[next] / xMax;
+			source += weights.source(matrix[xPos][yPos]);
+			sink   += weights.sink(matrix[xPos][yPos]);
+
+			int neighbors[4][2] = { { xPos - 1, yPos }, { xPos + 1, yPos }, { xPos, yPos - 1 }, { xPos, yPos + 1 } };
+			for (int i = 0; i < 4; ++i)
+			{
+				int xNext = neighbors[i][0];
+				int yNext = neighbors[i][1];
+				if (xNext < 0 || xNext >= xMax || yNext < 0 || yNext >= yMax)
+					continue;
+				int32_t index = (xMax * yNext) + xNext;
+				if (label[index] < 0 && std::abs(matrix[xNext][yNext] - seedValue) <= tolerance
+					&& weights.link(matrix[xNext][yNext], matrix[xPos][yPos]) > 0)
+				{
+					label[index] = region;
+					queue.push_back(index);
+				}
 			}
+		}
+		regions.source.push_back(source);
+		regions.sink.push_back(sink);
+	}
 
-			if (matrix[xPos][yPos] > threshold)
+	// Collect the kept n-links between different regions, each pair of pixels once, keyed by the pair of regions
+	int32_t count = regions.count();
+	std::vector< std::pair<uint64_t, int64_t> > boundary;
+	for (int yPos = 0; yPos < yMax; ++yPos)
+	{
+		for (int xPos = 0; xPos < xMax; ++xPos)
+		{
+			int32_t here = label[(xMax * yPos) + xPos];
+			int neighbors[2][2] = { { xPos + 1, yPos }, { xPos, yPos + 1 } };
+			for (int i = 0; i < 2; ++i)
 			{
-				vertex toT;
-				toT.id = sinkID;
-				toT.weight = matrix[xPos][yPos];
-				int fromID = (xMax * yPos) + xPos;
-				g.addNeighbor(fromID, toT);
+				int xNext = neighbors[i][0];
+				int yNext = neighbors[i][1];
+				if (xNext >= xMax || yNext >= yMax)
+					continue;
+				int32_t there = label[(xMax * yNext) + xNext];
+				int link = weights.link(matrix[xNext][yNext], matrix[xPos][yPos]);
+				if (there == here || link == 0)
+					continue;
+				uint64_t key = (static_cast<uint64_t>(std::min(here, there)) * count) + std::max(here, there);
+				boundary.push_back(std::make_pair(key, static_cast<int64_t>(link)));
 			}
 		}
 	}
+
+	// Add up the links of each pair of regions
+	std::sort(boundary.begin(), boundary.end());
+	size_t pairs = 0;
+	for (size_t i = 0; i < boundary.size(); ++i)
+	{
+		if (pairs > 0 && boundary[pairs - 1].first == boundary[i].first)
+			boundary[pairs - 1].second += boundary[i].second;
+		else
+			boundary[pairs++] = boundary[i];
+	}
+	boundary.resize(pairs);
+
+	// List every pair from both sides, region by region
+	regions.first.assign(static_cast<size_t>(count) + 1, 0);
+	for (size_t i = 0; i < pairs; ++i)
+	{
+		++regions.first[(boundary[i].first / count) + 1];
+		++regions.first[(boundary[i].first % count) + 1];
+	}
+	for (int32_t r = 0; r < count; ++r)
+		regions.first[r + 1] += regions.first[r];
+
+	std::vector<int32_t> next(regions.first.begin(), regions.first.end() - 1);
+	regions.neighbor.resize(2 * pairs);
+	regions.opposite.resize(2 * pairs);
+	regions.weight.resize(2 * pairs);
+	for (size_t i = 0; i < pairs; ++i)
+	{
+		int32_t a = boundary[i].first / count;
+		int32_t b = boundary[i].first % count;
+		int32_t fromA = next[a]++;
+		int32_t fromB = next[b]++;
+		regions.neighbor[fromA] = b;
+		regions.neighbor[fromB] = a;
+		regions.opposite[fromA] = fromB;
+		regions.opposite[fromB] = fromA;
+		regions.weight[fromA] = regions.weight[fromB] = boundary[i].second;
+	}
+	return count;
 }
 
+int Pgm::calculateThreshold()
+{
+	long int nodeSum = 0;
+	for (int xPos = 0; xPos < xMax; ++xPos)
+		for (int yPos = 0; yPos < yMax; ++yPos)
+			nodeSum += matrix[xPos][yPos];
+	
+	threshold = std::abs( pixMax - (nodeSum / (xMax * yMax)) );
+	return threshold;
+}
 
-bool Pgm::write(const char* file, int sourceID)
+bool Pgm::write(const char* file, const std::vector<bool>& foreground)
 {
 	std::ofstream output;
 	output.open(file);
@@ -160,7 +314,11 @@ bool Pgm::write(const char* file, int sourceID)
 		std::cerr << "Could not open file: " << file << "\n";
 		return false;
 	}
+	return write(output, foreground);
+}
 
+bool Pgm::write(std::ostream& output, const std::vector<bool>& foreground)
+{
 	output << "P2\n";
 	output << "# Created by IrfanView\n";
 	output << xMax << " " << yMax << "\n";
@@ -170,15 +328,123 @@ bool Pgm::write(const char* file, int sourceID)
 	{
 		for (int xPos = 0; xPos < xMax; xPos++)
 		{
-			int nodeID = (xMax * yPos) + xPos + 1;
-			if (g.adjList[sourceID].find(nodeID) == g.adjList[sourceID].end())
+			if (!foreground[nodeID(xPos, yPos)])
 				output << pixMax << " ";
 			else
 				output << matrix[xPos][yPos] << " ";
 		}
 		output << "\n";
 	}
-	output.close();
+	return !output.fail();
+}
+
+PgmReader::PgmReader() : xMax(0), yMax(0), pixMax(0), stream(NULL), raw(false)
+{
+}
+
+bool PgmReader::open(const char* path)
+{
+	name = path;
+	file.open(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Could not open file: " << path << "\n";
+		return false;
+	}
+	stream = &file;
+	return readHeader();
+}
+
+bool PgmReader::open(std::istream& source, const char* sourceName)
+{
+	name   = sourceName;
+	stream = &source;
+	return readHeader();
+}
+
+bool PgmReader::readHeader()
+{
+	std::istream& input = *stream;
+	std::string magic;
+	input >> magic;
+	raw = (magic == "P5");
+	if (!raw && magic != "P2")
+	{
+		std::cerr << "Not a PGM file: " << name << "\n";
+		return false;
+	}
+
+	// Width, height and maximum value, each of which may be preceded by comment lines
+	int* fields[] = { &xMax, &yMax, &pixMax };
+	for (int i = 0; i < 3; ++i)
+	{
+		input >> std::ws;
+		while (input.peek() == '#')
+		{
+			std::string comment;
+			getline(input, comment);
+			input >> std::ws;
+		}
+		input >> *fields[i];
+	}
+
+	// A single whitespace character separates the header from raw pixel data
+	if (raw)
+		input.get();
+
+	if (!input || xMax <= 0 || yMax <= 0 || pixMax <= 0 || pixMax > 65535)
+	{
+		std::cerr << "Invalid PGM header in file: " << name << "\n";
+		return false;
+	}
+	return true;
+}
+
+bool PgmReader::readRow(std::vector<int>& row)
+{
+	std::istream& input = *stream;
+	row.resize(xMax);
+	if (!raw)
+	{
+		for (int xPos = 0; xPos < xMax; ++xPos)
+			input >> row[xPos];
+		return !input.fail();
+	}
+
+	// Raw pixels are one byte each, or two bytes (most significant first) when the maximum value needs them
+	int bytes = (pixMax < 256) ? 1 : 2;
+	std::vector<unsigned char> data(static_cast<size_t>(xMax) * bytes);
+	input.read(reinterpret_cast<char*>(&data[0]), data.size());
+	for (int xPos = 0; xPos < xMax; ++xPos)
+		row[xPos] = (bytes == 1) ? data[xPos] : ((data[2 * xPos] << 8) | data[(2 * xPos) + 1]);
+	return !input.fail();
+}
+
+bool PgmWriter::open(const char* file, int xMax, int yMax, int pixMax)
+{
+	output.open(file);
+	if (!output)
+	{
+		std::cerr << "Could not open file: " << file << "\n";
+		return false;
+	}
+
+	output << "P2\n";
+	output << "# Created by IrfanView\n";
+	output << xMax << " " << yMax << "\n";
+	output << pixMax << "\n";
 	return true;
 }
 
+void PgmWriter::writeRow(const std::vector<int>& row)
+{
+	for (unsigned int xPos = 0; xPos < row.size(); xPos++)
+		output << row[xPos] << " ";
+	output << "\n";
+}
+
+bool PgmWriter::close()
+{
+	output.close();
+	return !output.fail();
+}
@@ -1,6 +1,67 @@
 #pragma once
 
-#include "graph.hpp"
+#include "network.hpp"
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! @brief Capacity functions of the image network, tabulated for every intensity and every difference of intensities
+//!	 so that building a network costs the same whichever function is chosen. Capacities that do not exceed the
+//!	 threshold are stored as 0.
+class WeightTable
+{
+public:
+	//! @brief Capacity functions for the links between neighboring pixels. LINEAR is pixMax - |a - b|. GAUSSIAN is
+	//!	 pixMax * exp(-(a - b)^2 / 2 sigma^2), the usual boundary term. Both link a pixel of intensity v to the source
+	//!	 with capacity pixMax - v and to the sink with capacity v.
+	enum Function { LINEAR, GAUSSIAN };
+
+	//! @brief Fills the tables
+	//! @param function The link capacity function
+	//! @param pixMax Maximum pixel value
+	//! @param threshold Capacities up to this value are left out of the network
+	//! @param sigma Spread of the GAUSSIAN function, in intensity levels. 0 picks pixMax / 8.
+	void build(Function function, int pixMax, int threshold, double sigma);
+
+	//! @brief Capacity of the link between two neighboring pixels
+	int link(int a, int b) const { return links[std::abs(a - b)]; }
+
+	//! @brief Capacity of the link from the source to a pixel
+	int source(int value) const { return sources[value]; }
+
+	//! @brief Capacity of the link from a pixel to the sink
+	int sink(int value) const { return sinks[value]; }
+
+private:
+	std::vector<int> links;		// By difference of intensities
+	std::vector<int> sources;	// By intensity
+	std::vector<int> sinks;		// By intensity
+};
+
+//! @brief Connected regions of nearly equal pixels, found by Pgm::findRegions, with the summed capacities of the
+//!	 links of the pixels in each region. Links between the pixels of the same region are dropped; links between
+//!	 neighboring regions are added together into one link per pair of regions.
+struct flatRegions
+{
+	std::vector<int32_t> label;		//! Region of each pixel, by raster index (xMax * yPos + xPos)
+	std::vector<int64_t> source;	//! Capacity from the source to each region
+	std::vector<int64_t> sink;		//! Capacity from each region to the sink
+	std::vector<int32_t> first;		//! Position in neighbor of each region's first neighbor, and the total at the end
+	std::vector<int32_t> neighbor;	//! Regions next to each region. Every pair is listed once from each side.
+	std::vector<int32_t> opposite;	//! Position in neighbor of the same pair listed from the other side
+	std::vector<int64_t> weight;	//! Capacity of the link between the pair
+
+	//! @brief Gets the number of regions
+	int32_t count() const { return static_cast<int32_t>(source.size()); }
+};
+
+class PgmReader;
 
 //! @brief Container for a PGM image
 class Pgm
@@ -13,33 +74,503 @@ public:
 	~Pgm();
 
 	//! @brief Construct from a file
-	//! @param file Path to the PGM file
+	//! @param file Path to a plain (P2) or raw (P5) PGM file, of up to 16 bits per pixel
 	//! @retval true if successful, false otherwise
 	bool fromFile(const char* file);
 
+	//! @brief Construct from the pixels of a reader whose header has been read. The matrix of an earlier image is
+	//!	 reused if it is large enough.
+	//! @param reader The open reader, left at the end of the image
+	//! @retval true if successful, false if the image ended early
+	bool fromReader(PgmReader& reader);
+
+	//! @brief Construct from pixels in memory. The matrix of an earlier image is reused if it is large enough.
+	//! @param pixels First pixel of the top row
+	//! @param width Pixels per row
+	//! @param height Number of rows
+	//! @param stride Bytes from the start of one row to the start of the next
+	//! @param depth Bits per pixel, 1 to 16. Pixels of more than 8 bits take two bytes, in native byte order.
+	//! @retval true if successful, false for an unsupported size or depth
+	bool fromPixels(const void* pixels, int width, int height, size_t stride, int depth);
+
 	//! @brief Gets the threshold for the file
 	//! @param The average of all nodes - constituting the threshold
 	int calculateThreshold();
 
-	//! @brief Add paths between all pixels
-	void addPaths();
+	//! @brief Slots of the arcs held by every pixel node. Pixel p owns arcs ARCS_PER_PIXEL * p onwards, in this order;
+	//!	 a slot without a neighbor (at the image border) holds an empty arc back to the pixel itself.
+	enum PixelArc { LEFT, RIGHT, TOP, BOTTOM, FROM_SOURCE, TO_SINK, ARCS_PER_PIXEL };
+
+	//! @brief Orders in which pixels are numbered as network nodes. RASTER numbers them row by row. TILED numbers the
+	//!	 pixels of each TILE_SIZE square block together, row by row within the block, so a pixel's vertical neighbors
+	//!	 are close in memory. MORTON is TILED with a Z-order curve inside every full block.
+	enum NodeLayout { RASTER, TILED, MORTON };
+
+	static const int TILE_SIZE = 32;	//!< Width and height of the blocks of the TILED and MORTON layouts
+
+	//! @brief Gets the number of arcs in the network addPaths builds for a number of pixels, or addComponent for a
+	//!	 component of that many: ARCS_PER_PIXEL for each pixel, and one from the source and one from the sink.
+	//!	 Arc positions run up to this value, so it must fit the network's Index type.
+	static int64_t networkArcs(int64_t pixels)
+	{
+		return (ARCS_PER_PIXEL + 2) * pixels;
+	}
+
+	//! @brief Gets the network node of a pixel in the current layout. The nodes of a w by h image are always 0 to
+	//!	 w * h - 1.
+	//! @param xPos Column
+	//! @param yPos Row
+	//! @retval The node ID
+	int64_t nodeID(int xPos, int yPos) const
+	{
+		if (layout == RASTER)
+			return (static_cast<int64_t>(xMax) * yPos) + xPos;
+
+		// Blocks are numbered row by row; the blocks on the right and bottom edges may be cut short
+		int tileLeft   = xPos - (xPos % TILE_SIZE);
+		int tileTop    = yPos - (yPos % TILE_SIZE);
+		int tileWidth  = std::min(TILE_SIZE, xMax - tileLeft);
+		int tileHeight = std::min(TILE_SIZE, yMax - tileTop);
+		int64_t tileStart = (static_cast<int64_t>(xMax) * tileTop) + (static_cast<int64_t>(tileLeft) * tileHeight);
+
+		if (layout == MORTON && tileWidth == TILE_SIZE && tileHeight == TILE_SIZE)
+			return tileStart + (spreadBits(xPos - tileLeft) | (spreadBits(yPos - tileTop) << 1));
+		return tileStart + ((yPos - tileTop) * tileWidth) + (xPos - tileLeft);
+	}
 
-	//! @brief Adds super source and super sink
-	//! @param sourceID The node ID of the source
-	//! @param sinkID	The node ID of the sink
-	void addSuperNodes(int sourceID, int sinkID);
+	//! @brief Add paths between all pixels. Allocates the network with one node per pixel plus the super source and
+	//!	 super sink, and fills the n-links between neighboring pixels. Each pair of neighbors shares one arc pair
+	//!	 whose two arcs carry the same weight. The weight table for the threshold and weight function is built first.
+	//!	 Large images are filled in bands of rows, one per thread.
+	//! @param net The network to build
+	template<typename Cap, typename Index>
+	void addPaths(FlowNetwork<Cap, Index>& net)
+	{
+		weights.build(weight, pixMax, threshold, sigma);
 
-	//! @brief Write a cut PGM given a source ID to start the segmentation
+		Index pixels = static_cast<Index>(xMax) * yMax;
+		net.allocate(pixels + 2, networkArcs(pixels));
+
+		// Pixel arcs first, then one arc from the source and one from the sink for every pixel
+		for (Index p = 0; p <= pixels; ++p)
+			net.first[p] = ARCS_PER_PIXEL * p;
+		net.first[pixels + 1] = (ARCS_PER_PIXEL + 1) * pixels;
+		net.first[pixels + 2] = networkArcs(pixels);
+
+		linkBand<Cap, Index> band = { this, &net };
+		forEachBand(band);
+	}
+
+	//! @brief Adds super source and super sink, and resets every residual capacity to its base. Must follow addPaths
+	//!	 on the same network. The source is the node after the last pixel and the sink the node after that.
+	//! @param net The network built by addPaths
+	template<typename Cap, typename Index>
+	void addSuperNodes(FlowNetwork<Cap, Index>& net)
+	{
+		Index pixels = static_cast<Index>(xMax) * yMax;
+		terminalBand<Cap, Index> band = { this, &net };
+		forEachBand(band);
+
+		net.source = pixels;
+		net.sink   = pixels + 1;
+	}
+
+	//! @brief Groups the pixels into the connected components of the n-links that addPaths would keep. Components
+	//!	 share nothing but the super source and super sink, so each one can be solved on its own. Builds the weight
+	//!	 table as addPaths does.
+	//! @param start Filled with the position in pixels of the first pixel of each component, and the number of pixels
+	//!	 at the end
+	//! @param pixels Filled with the raster index (xMax * yPos + xPos) of every pixel, component by component. The
+	//!	 pixels of a component are in node layout order.
+	//! @retval The number of components
+	int findComponents(std::vector<int32_t>& start, std::vector<int32_t>& pixels);
+
+	//! @brief Builds the network of one component found by findComponents, as addPaths and addSuperNodes build the
+	//!	 network of the whole image. The pixels are numbered in the order given, followed by the source and the sink.
+	//! @param net The network to build
+	//! @param pixels Raster indices of the pixels of the component
+	//! @param count Number of pixels in the component
+	//! @param localID Scratch space of one entry per pixel in the image. Set to each pixel's node in net.
+	template<typename Cap, typename Index>
+	void addComponent(FlowNetwork<Cap, Index>& net, const int32_t* pixels, Index count, std::vector<Index>& localID)
+	{
+		net.allocate(count + 2, networkArcs(count));
+		for (Index p = 0; p <= count; ++p)
+			net.first[p] = ARCS_PER_PIXEL * p;
+		net.first[count + 1] = (ARCS_PER_PIXEL + 1) * count;
+		net.first[count + 2] = networkArcs(count);
+		for (Index p = 0; p < count; ++p)
+			localID[pixels[p]] = p;
+
+		Index sourceID = count;
+		Index sinkID   = count + 1;
+		for (Index p = 0; p < count; ++p)
+		{
+			int xPos = pixels[p] % xMax;
+			int yPos = pixels[p] / xMax;
+			Index arcs = ARCS_PER_PIXEL * p;
+
+			// A neighbor joined by a kept n-link is in the same component. Dropped links carry nothing, so they
+			// become empty slots, like the image border.
+			for (int direction = LEFT; direction <= BOTTOM; ++direction)
+			{
+				int xNext = xPos + ((direction == LEFT) ? -1 : (direction == RIGHT) ? 1 : 0);
+				int yNext = yPos + ((direction == TOP) ? -1 : (direction == BOTTOM) ? 1 : 0);
+				bool exists = xNext >= 0 && xNext < xMax && yNext >= 0 && yNext < yMax;
+				int weight = exists ? weights.link(matrix[xNext][yNext], matrix[xPos][yPos]) : 0;
+				Index arc = arcs + direction;
+				if (weight == 0)
+				{
+					net.head[arc] = p;
+					net.rev[arc]  = arc;
+					net.base[arc] = 0;
+					continue;
+				}
+
+				Index neighborID = localID[(xMax * yNext) + xNext];
+				net.head[arc] = neighborID;
+				net.rev[arc]  = (ARCS_PER_PIXEL * neighborID) + (direction ^ 1);	// LEFT <-> RIGHT, TOP <-> BOTTOM
+				net.base[arc] = weight;
+			}
+
+			Index fromS = net.first[sourceID] + p;
+			Index fromT = net.first[sinkID] + p;
+			net.head[fromS] = p;
+			net.rev[fromS]  = arcs + FROM_SOURCE;
+			net.base[fromS] = weights.source(matrix[xPos][yPos]);
+			net.head[arcs + FROM_SOURCE] = sourceID;
+			net.rev[arcs + FROM_SOURCE]  = fromS;
+			net.base[arcs + FROM_SOURCE] = 0;
+
+			net.head[arcs + TO_SINK] = sinkID;
+			net.rev[arcs + TO_SINK]  = fromT;
+			net.base[arcs + TO_SINK] = weights.sink(matrix[xPos][yPos]);
+			net.head[fromT] = p;
+			net.rev[fromT]  = arcs + TO_SINK;
+			net.base[fromT] = 0;
+		}
+
+		net.source = sourceID;
+		net.sink   = sinkID;
+		net.reset();
+	}
+
+	//! @brief Merges the pixels into flat regions: connected groups of pixels within a tolerance of the first pixel of
+	//!	 the group, in raster order, joined by n-links that addPaths would keep. Regions never span two components.
+	//!	 Builds the weight table as addPaths does.
+	//! @param tolerance Largest difference from the first pixel of a region, 0 for equal pixels only
+	//! @param regions Filled with the regions and the summed capacities of their links
+	//! @retval The number of regions
+	int32_t findRegions(int tolerance, flatRegions& regions);
+
+	//! @brief Builds a network with one node per region found by findRegions, followed by the source and the sink.
+	//!	 Each region has the links of flatRegions in the order listed, then its arc to the source and its arc to the
+	//!	 sink. The cut of this network is the cut of the pixel network with every region kept on one side.
+	//! @param net The network to build
+	//! @param regions The regions
+	template<typename Cap, typename Index>
+	void addRegions(FlowNetwork<Cap, Index>& net, const flatRegions& regions)
+	{
+		Index count = regions.count();
+		Index links = regions.neighbor.size();
+		net.allocate(count + 2, links + (4 * count));
+
+		// Region arcs first, then one arc from the source and one from the sink for every region
+		for (Index r = 0; r <= count; ++r)
+			net.first[r] = regions.first[r] + (2 * r);
+		net.first[count + 1] = links + (3 * count);
+		net.first[count + 2] = links + (4 * count);
+
+		Index sourceID = count;
+		Index sinkID   = count + 1;
+		for (Index r = 0; r < count; ++r)
+		{
+			for (Index i = regions.first[r]; i < regions.first[r + 1]; ++i)
+			{
+				Index other = regions.neighbor[i];
+				net.head[i + (2 * r)] = other;
+				net.rev[i + (2 * r)]  = regions.opposite[i] + (2 * other);
+				net.base[i + (2 * r)] = regions.weight[i];
+			}
+
+			Index arcs  = regions.first[r + 1] + (2 * r);	// To the source, then to the sink
+			Index fromS = net.first[sourceID] + r;
+			Index fromT = net.first[sinkID] + r;
+			net.head[fromS] = r;
+			net.rev[fromS]  = arcs;
+			net.base[fromS] = regions.source[r];
+			net.head[arcs] = sourceID;
+			net.rev[arcs]  = fromS;
+			net.base[arcs] = 0;
+
+			net.head[arcs + 1] = sinkID;
+			net.rev[arcs + 1]  = fromT;
+			net.base[arcs + 1] = regions.sink[r];
+			net.head[fromT] = r;
+			net.rev[fromT]  = arcs + 1;
+			net.base[fromT] = 0;
+		}
+
+		net.source = sourceID;
+		net.sink   = sinkID;
+		net.reset();
+	}
+
+	//! @brief Gets the capacities of the t-links of a pixel, from the weight table built by addPaths or findComponents
+	//! @param xPos Column
+	//! @param yPos Row
+	//! @param source Set to the capacity from the source
+	//! @param sink Set to the capacity to the sink
+	void terminalWeights(int xPos, int yPos, int& source, int& sink) const
+	{
+		source = weights.source(matrix[xPos][yPos]);
+		sink   = weights.sink(matrix[xPos][yPos]);
+	}
+
+	//! @brief Write a cut PGM, keeping the pixels on the source side of the cut and whitening the rest
 	//! @param file The path to the file that will be written to
-	//! @param sourceID The source of the PGM
+	//! @param foreground For each pixel node, in the layout the network was built with, true if it is on the source side
+	//!	 of the cut
+	//! @retval true if successful, false otherwise
+	bool write(const char* file, const std::vector<bool>& foreground);
+
+	//! @brief Write a cut PGM to a stream, as write does to a file
+	//! @param output The stream to write to
+	//! @param foreground For each pixel node, true if it is on the source side of the cut
 	//! @retval true if successful, false otherwise
-	bool write(const char* file, int sourceID);
+	bool write(std::ostream& output, const std::vector<bool>& foreground);
 
 
 	int **matrix;	// Matrix constructed of all pixels
-	Graph g;		// Graph of all nodes representing the pixels
 	int xMax;		// Maximum x value
 	int yMax;		// Maximum y value
 	int pixMax;		// Maximum pixel value
 	int threshold;	// Threshold value for the min cut
+	NodeLayout layout;	// Numbering of the pixel nodes, used from addPaths until write
+	WeightTable::Function weight;	// Capacity function of the links between pixels
+	double sigma;		// Spread of the GAUSSIAN weight function, or 0 for the default
+	int threads;		// Threads filling the network in addPaths and addSuperNodes, or 0 for one per core
+
+private:
+	//! @brief Makes the matrix hold at least width by height pixels, keeping it if it already does
+	void reserve(int width, int height);
+
+	int xCapacity;	// Columns allocated in matrix
+	int yCapacity;	// Rows allocated in each column
+	WeightTable weights;	// Capacities for the current threshold and weight function, filled by addPaths
+
+	//! @brief Fills the n-links of the pixels in a band of rows
+	//! @param net The network allocated by addPaths
+	//! @param yBegin First row
+	//! @param yEnd Row after the last
+	template<typename Cap, typename Index>
+	void linkRows(FlowNetwork<Cap, Index>& net, int yBegin, int yEnd)
+	{
+		for (int yPos = yBegin; yPos < yEnd; ++yPos)
+		{
+			for (int xPos = 0; xPos < xMax; ++xPos)
+			{
+				Index currentID = nodeID(xPos, yPos);
+				Index arcs = ARCS_PER_PIXEL * currentID;
+
+				setLink(net, arcs + LEFT, xPos > 0, xPos, yPos, xPos - 1, yPos, RIGHT);
+				setLink(net, arcs + RIGHT, xPos < (xMax - 1), xPos, yPos, xPos + 1, yPos, LEFT);
+				setLink(net, arcs + TOP, yPos > 0, xPos, yPos, xPos, yPos - 1, BOTTOM);
+				setLink(net, arcs + BOTTOM, yPos < (yMax - 1), xPos, yPos, xPos, yPos + 1, TOP);
+			}
+		}
+	}
+
+	//! @brief Fills the t-links of the pixels in a band of rows, and sets the residual capacity of each of their arcs
+	//!	 to its base
+	//! @param net The network built by addPaths
+	//! @param yBegin First row
+	//! @param yEnd Row after the last
+	template<typename Cap, typename Index>
+	void terminalRows(FlowNetwork<Cap, Index>& net, int yBegin, int yEnd)
+	{
+		Index pixels = static_cast<Index>(xMax) * yMax;
+		Index sourceID = pixels;
+		Index sinkID   = pixels + 1;
+
+		for (int yPos = yBegin; yPos < yEnd; ++yPos)
+		{
+			for (int xPos = 0; xPos < xMax; ++xPos)
+			{
+				Index currentID = nodeID(xPos, yPos);
+				Index fromS = net.first[sourceID] + currentID;	// Source -> pixel, paired with FROM_SOURCE
+				Index fromT = net.first[sinkID] + currentID;	// Sink -> pixel, paired with TO_SINK
+				Index arcs  = ARCS_PER_PIXEL * currentID;
+
+				net.head[fromS] = currentID;
+				net.rev[fromS]  = arcs + FROM_SOURCE;
+				net.base[fromS] = weights.source(matrix[xPos][yPos]);
+				net.head[arcs + FROM_SOURCE] = sourceID;
+				net.rev[arcs + FROM_SOURCE]  = fromS;
+				net.base[arcs + FROM_SOURCE] = 0;
+
+				net.head[arcs + TO_SINK] = sinkID;
+				net.rev[arcs + TO_SINK]  = fromT;
+				net.base[arcs + TO_SINK] = weights.sink(matrix[xPos][yPos]);
+				net.head[fromT] = currentID;
+				net.rev[fromT]  = arcs + TO_SINK;
+				net.base[fromT] = 0;
+
+				for (Index arc = arcs; arc < arcs + ARCS_PER_PIXEL; ++arc)
+					net.cap[arc] = net.base[arc];
+				net.cap[fromS] = net.base[fromS];
+				net.cap[fromT] = net.base[fromT];
+			}
+		}
+	}
+
+	//! @brief Calls linkRows for one band, from a thread of its own
+	template<typename Cap, typename Index>
+	struct linkBand
+	{
+		Pgm* image;
+		FlowNetwork<Cap, Index>* net;
+
+		void operator()(int yBegin, int yEnd) const
+		{
+			image->linkRows(*net, yBegin, yEnd);
+		}
+	};
+
+	//! @brief Calls terminalRows for one band, from a thread of its own
+	template<typename Cap, typename Index>
+	struct terminalBand
+	{
+		Pgm* image;
+		FlowNetwork<Cap, Index>* net;
+
+		void operator()(int yBegin, int yEnd) const
+		{
+			image->terminalRows(*net, yBegin, yEnd);
+		}
+	};
+
+	//! @brief Splits the rows into one band per thread and calls a band functor on each, the last on this thread.
+	//!	 Every pixel owns its own arc slots and finds those of its neighbors by arithmetic, so the bands write
+	//!	 disjoint parts of the network and need no locks.
+	//! @param band Functor called with the first row of a band and the row after its last
+	template<typename Band>
+	void forEachBand(Band band)
+	{
+		// A band smaller than this takes longer to start a thread for than to fill
+		const int64_t minimumPixels = 1 << 16;
+		int64_t count = (threads > 0) ? threads : std::max(1u, std::thread::hardware_concurrency());
+		count = std::min(count, (static_cast<int64_t>(xMax) * yMax) / minimumPixels);
+		count = std::max<int64_t>(1, std::min<int64_t>(count, yMax));
+
+		std::vector<std::thread> workers;
+		for (int64_t i = 0; i < count; ++i)
+		{
+			int yBegin = static_cast<int>((yMax * i) / count);
+			int yEnd   = static_cast<int>((yMax * (i + 1)) / count);
+			if (i + 1 < count)
+				workers.push_back(std::thread(band, yBegin, yEnd));
+			else
+				band(yBegin, yEnd);
+		}
+		for (size_t i = 0; i < workers.size(); ++i)
+			workers[i].join();
+	}
+
+	//! @brief Moves the low 16 bits of a value to the even bit positions, for Z-order numbering
+	static int spreadBits(int value)
+	{
+		value = (value | (value << 8)) & 0x00FF00FF;
+		value = (value | (value << 4)) & 0x0F0F0F0F;
+		value = (value | (value << 2)) & 0x33333333;
+		value = (value | (value << 1)) & 0x55555555;
+		return value;
+	}
+
+	//! @brief Fills one n-link slot of a pixel
+	//! @param net The network being built
+	//! @param arc The slot to fill
+	//! @param exists Whether the neighbor is inside the image
+	//! @param xPos, yPos The pixel
+	//! @param xNext, yNext The neighbor
+	//! @param opposite The slot of the neighbor that points back at this pixel
+	template<typename Cap, typename Index>
+	void setLink(FlowNetwork<Cap, Index>& net, Index arc, bool exists, int xPos, int yPos, int xNext, int yNext,
+		PixelArc opposite)
+	{
+		if (!exists)
+		{
+			net.head[arc] = arc / ARCS_PER_PIXEL;
+			net.rev[arc]  = arc;
+			net.base[arc] = 0;
+			return;
+		}
+
+		Index neighborID = nodeID(xNext, yNext);
+		net.head[arc] = neighborID;
+		net.rev[arc]  = (ARCS_PER_PIXEL * neighborID) + opposite;
+		net.base[arc] = weights.link(matrix[xNext][yNext], matrix[xPos][yPos]);
+	}
+};
+
+//! @brief Reads a PGM image one row at a time, for images too large to hold in memory
+class PgmReader
+{
+public:
+	//! @brief Basic constructor
+	PgmReader();
+
+	//! @brief Opens a plain (P2) or raw (P5) PGM file and reads its header
+	//! @param file Path to the PGM file
+	//! @retval true if successful, false otherwise
+	bool open(const char* file);
+
+	//! @brief Reads the header of the next PGM image in a stream. Images may follow one another in the same stream,
+	//!	 each read once the rows of the one before it have been.
+	//! @param source The stream, which must outlive the reader
+	//! @param sourceName Name of the stream for error messages
+	//! @retval true if successful, false otherwise
+	bool open(std::istream& source, const char* sourceName);
+
+	//! @brief Reads the next row of pixels
+	//! @param row Filled with xMax pixel values
+	//! @retval true if successful, false if the file ended early
+	bool readRow(std::vector<int>& row);
+
+	int xMax;		// Maximum x value
+	int yMax;		// Maximum y value
+	int pixMax;		// Maximum pixel value
+	std::string name;	// File or stream being read, for error messages
+
+private:
+	//! @brief Reads the header from the current input
+	bool readHeader();
+
+	std::ifstream file;		// The open PGM file, if reading from a file
+	std::istream* stream;	// The file or stream being read
+	bool raw;				// True for P5 files, false for P2
+};
+
+//! @brief Writes a plain PGM image one row at a time, in the same form as Pgm::write
+class PgmWriter
+{
+public:
+	//! @brief Creates the file and writes the header
+	//! @param file The path to the file that will be written to
+	//! @param xMax Width of the image
+	//! @param yMax Height of the image
+	//! @param pixMax Maximum pixel value
+	//! @retval true if successful, false otherwise
+	bool open(const char* file, int xMax, int yMax, int pixMax);
+
+	//! @brief Writes the next row of pixels
+	//! @param row The pixel values of the row
+	void writeRow(const std::vector<int>& row);
+
+	//! @brief Finishes the file
+	//! @retval true if everything was written, false otherwise
+	bool close();
+
+private:
+	std::ofstream output;	// The PGM file being written
 };
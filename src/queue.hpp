@@ -0,0 +1,58 @@
+/*
+	@brief Blocking queue of bounded length, for passing work between the stages of a pipeline.
+	@author Drew Guarnera, Bharath Bogadamidi, Heather Michaud
+	@version 0.9
+	@copyright Copyright 2014 Guarnera, Bogadamidi, Michaud. All rights reserved.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+//! @brief First in, first out queue shared by one producing and one consuming thread. A full queue blocks the producer
+//!	 until the consumer catches up, so a fast stage cannot run arbitrarily far ahead of a slow one.
+template<typename T>
+class BoundedQueue
+{
+public:
+	//! @brief Constructor
+	//! @param capacity Most items the queue holds before push blocks
+	BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+	//! @brief Adds an item to the back, waiting while the queue is full
+	//! @param item The item
+	void push(const T& item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (items.size() >= capacity)
+			notFull.wait(lock);
+		items.push_back(item);
+		notEmpty.notify_one();
+	}
+
+	//! @brief Removes the item at the front, waiting while the queue is empty
+	//! @retval The item
+	T pop()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (items.empty())
+			notEmpty.wait(lock);
+		T item = items.front();
+		items.pop_front();
+		notFull.notify_one();
+		return item;
+	}
+
+private:
+	size_t capacity;					// Most items held at once
+	std::deque<T> items;				// Items waiting, oldest first
+	std::mutex mutex;					// Guards items
+	std::condition_variable notFull;	// Signalled when an item is removed
+	std::condition_variable notEmpty;	// Signalled when an item is added
+
+	BoundedQueue(const BoundedQueue&);
+	BoundedQueue& operator=(const BoundedQueue&);
+};
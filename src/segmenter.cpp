@@ -0,0 +1,102 @@
+/*
+	@copydoc segmenter.hpp
+*/
+
+#include "segmenter.hpp"
+#include "iseg.h"
+#include <new>
+#include <iostream>
+
+Segmenter::Segmenter() : maxFlow(0), cutCapacity(0)
+{
+}
+
+Segmenter::Segmenter(const Tools::segmentOptions& o) : options(o), maxFlow(0), cutCapacity(0)
+{
+}
+
+bool Segmenter::segment(const void* pixels, int width, int height, size_t stride, int depth, uint8_t* mask,
+	size_t maskStride)
+{
+	Tools::Deadline deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeBudget);
+	if (!mask || !image.fromPixels(pixels, width, height, stride, depth))
+		return false;
+	if (Pgm::networkArcs(static_cast<int64_t>(width) * height) >= INT32_MAX)
+	{
+		std::cerr << "Image too large to segment in memory: " << width << "x" << height << "\n";
+		return false;
+	}
+
+	image.layout = options.layout;
+	image.weight = options.weight;
+	image.sigma  = options.sigma;
+	image.threads = options.threads;
+	image.calculateThreshold();
+
+	// Both directions of an n-link share one arc pair, so a residual capacity can reach twice the largest pixel value
+	if (2 * image.pixMax <= INT16_MAX)
+		solve(narrowNetwork, deadline, mask, maskStride);
+	else
+		solve(wideNetwork, deadline, mask, maskStride);
+	return true;
+}
+
+template<typename Cap>
+void Segmenter::solve(FlowNetwork<Cap, int32_t>& network, const Tools::Deadline& deadline, uint8_t* mask,
+	size_t maskStride)
+{
+	image.addPaths(network);
+	image.addSuperNodes(network);
+
+	const Tools::Deadline* stop = (options.timeBudget > 0) ? &deadline : NULL;
+	maxFlow = 0;
+	if (options.warmStart)
+		maxFlow = Tools::greedyFlow(network, network.source, network.sink, options.searchLimit, stop, workspace);
+	maxFlow = Tools::fordFulkerson(network, network.source, network.sink, maxFlow, stop, workspace);
+	cutCapacity = Tools::boundingCut(network, network.source, network.sink, foreground, workspace);
+
+	for (int yPos = 0; yPos < image.yMax; ++yPos)
+	{
+		uint8_t* row = mask + (maskStride * yPos);
+		for (int xPos = 0; xPos < image.xMax; ++xPos)
+			row[xPos] = foreground[image.nodeID(xPos, yPos)] ? 1 : 0;
+	}
+}
+
+struct iseg_segmenter
+{
+	Segmenter segmenter;
+};
+
+extern "C"
+{
+	iseg_segmenter* iseg_create(void)
+	{
+		return new (std::nothrow) iseg_segmenter;
+	}
+
+	void iseg_destroy(iseg_segmenter* segmenter)
+	{
+		delete segmenter;
+	}
+
+	void iseg_set_time_budget(iseg_segmenter* segmenter, long milliseconds)
+	{
+		segmenter->segmenter.options.timeBudget = milliseconds;
+	}
+
+	int iseg_segment(iseg_segmenter* segmenter, const void* pixels, int width, int height, size_t stride, int depth,
+		unsigned char* mask, size_t mask_stride)
+	{
+		// Nothing may be thrown across the C interface; running out of memory is reported as a failure
+		try
+		{
+			return segmenter->segmenter.segment(pixels, width, height, stride, depth, mask, mask_stride) ? 0 : -1;
+		}
+		catch (const std::bad_alloc&)
+		{
+			std::cerr << "Out of memory segmenting a " << width << "x" << height << " image\n";
+			return -1;
+		}
+	}
+}
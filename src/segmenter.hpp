@@ -0,0 +1,60 @@
+/*
+	@brief Segments images that are already in memory, reusing the network and solver buffers from one image to the
+	 next.
+	@author Drew Guarnera, Bharath Bogadamidi, Heather Michaud
+	@version 0.9
+	@copyright Copyright 2014 Guarnera, Bogadamidi, Michaud. All rights reserved.
+*/
+
+#pragma once
+
+#include "tools.hpp"
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+//! @brief Separates the foreground from the background of images held by the caller, as Tools::segmentImage does for
+//!	 pgm files. Storage grows to fit the largest image seen and is kept, so segmenting a stream of images of similar
+//!	 size allocates nothing after the first.
+class Segmenter
+{
+public:
+	//! @brief Basic constructor, with the default options
+	Segmenter();
+
+	//! @brief Constructor
+	//! @param options How to build and solve the network for each image
+	Segmenter(const Tools::segmentOptions& options);
+
+	//! @brief Segments one image
+	//! @param pixels First pixel of the top row. Not kept after the call.
+	//! @param width Pixels per row
+	//! @param height Number of rows
+	//! @param stride Bytes from the start of one row to the start of the next
+	//! @param depth Bits per pixel, 1 to 16. The maximum pixel value is 2^depth - 1. Pixels of more than 8 bits take two
+	//!	 bytes, in native byte order.
+	//! @param mask Set to 1 for every foreground pixel and 0 for the rest, one byte per pixel
+	//! @param maskStride Bytes from the start of one row of the mask to the start of the next
+	//! @retval true if successful, false otherwise
+	bool segment(const void* pixels, int width, int height, size_t stride, int depth, uint8_t* mask,
+		size_t maskStride);
+
+	Tools::segmentOptions options;	// How to build and solve the network
+	int64_t maxFlow;				// Flow found for the last image
+	int64_t cutCapacity;			// Capacity of the cut written for the last image. Above maxFlow only if the time
+									// budget ran out.
+
+private:
+	//! @brief Builds, solves and cuts the network for the image in the matrix
+	template<typename Cap>
+	void solve(FlowNetwork<Cap, int32_t>& network, const Tools::Deadline& deadline, uint8_t* mask, size_t maskStride);
+
+	Pgm image;										// Pixels of the current image
+	FlowNetwork<int16_t, int32_t> narrowNetwork;	// Network for images of up to 14 bits per pixel
+	FlowNetwork<int32_t, int32_t> wideNetwork;		// Network for deeper images
+	Tools::FlowWorkspace<int32_t> workspace;		// Search buffers shared by every solve
+	std::vector<bool> foreground;					// Source side of the last cut, by node
+
+	Segmenter(const Segmenter&);
+	Segmenter& operator=(const Segmenter&);
+};
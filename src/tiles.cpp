@@ -0,0 +1,203 @@
+/*
+	@copydoc tiles.hpp
+*/
+
+#include "tiles.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+TileStore::TileStore() : width(0), height(0), tileRows(1), tiles(0), maxResident(0), tileLoads(0), failed(false),
+	fd(-1), lastTile(-1), lastPixels(NULL)
+{
+}
+
+TileStore::~TileStore()
+{
+	for (unsigned int tile = 0; tile < slots.size(); ++tile)
+		if (slots[tile].pixels)
+			munmap(slots[tile].mapping, slots[tile].mappingSize);
+	if (fd >= 0)
+		close(fd);
+}
+
+bool TileStore::create(int w, int h, size_t budget, const char* directory)
+{
+	width  = w;
+	height = h;
+	if (width <= 0 || height <= 0)
+		return false;
+
+	// Aim for eight resident tiles, but never fewer than three so that a pixel, its neighbor and the tile being
+	// mapped can all be held at once
+	size_t rowBytes = sizeof(tilePixel) * width;
+	tileRows = std::max<size_t>(1, std::min<size_t>(height, budget / (8 * rowBytes)));
+	tiles = (height + tileRows - 1) / tileRows;
+	maxResident = std::max<size_t>(3, budget / (rowBytes * tileRows));
+
+	std::string path = std::string(directory) + "/iseg-tiles-XXXXXX";
+	std::vector<char> name(path.begin(), path.end());
+	name.push_back('\0');
+	fd = mkstemp(&name[0]);
+	if (fd < 0)
+	{
+		std::cerr << "Could not create scratch file in: " << directory << "\n";
+		return false;
+	}
+	unlink(&name[0]);
+
+	if (ftruncate(fd, static_cast<off_t>(rowBytes) * height) != 0)
+	{
+		std::cerr << "Could not size scratch file in: " << directory << "\n";
+		return false;
+	}
+
+	residentTile empty = { NULL, NULL, 0, recentTiles.end() };
+	slots.assign(tiles, empty);
+	return true;
+}
+
+void TileStore::use(int tile)
+{
+	residentTile& slot = slots[tile];
+	if (slot.pixels)
+	{
+		recentTiles.splice(recentTiles.begin(), recentTiles, slot.recent);
+	}
+	else
+	{
+		// Make room by unmapping the least recently used tile. Its pages are written back to the scratch file.
+		if (recentTiles.size() >= maxResident)
+		{
+			residentTile& oldest = slots[recentTiles.back()];
+			munmap(oldest.mapping, oldest.mappingSize);
+			oldest.pixels = NULL;
+			recentTiles.pop_back();
+		}
+
+		static const size_t pageSize = sysconf(_SC_PAGESIZE);
+		size_t rowBytes = sizeof(tilePixel) * width;
+		size_t offset   = rowBytes * tile * tileRows;
+		size_t rows     = std::min(tileRows, height - (tile * tileRows));
+		size_t aligned  = offset - (offset % pageSize);
+
+		slot.mappingSize = (offset - aligned) + (rowBytes * rows);
+		slot.mapping = mmap(NULL, slot.mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, aligned);
+		if (slot.mapping == MAP_FAILED)
+		{
+			// Hand out scratch pixels so the caller can run on until it checks failed
+			if (!failed)
+				std::cerr << "Could not map tile " << tile << " of the scratch file\n";
+			failed = true;
+			fallback.assign(static_cast<size_t>(width) * tileRows, tilePixel());
+			lastTile   = tile;
+			lastPixels = &fallback[0];
+			return;
+		}
+		slot.pixels = reinterpret_cast<tilePixel*>(static_cast<char*>(slot.mapping) + (offset - aligned));
+		recentTiles.push_front(tile);
+		slot.recent = recentTiles.begin();
+		++tileLoads;
+	}
+
+	lastTile   = tile;
+	lastPixels = slot.pixels;
+}
+
+SpillQueue::SpillQueue(size_t l) : limit(std::max<size_t>(l, 1024)), spill(NULL), spillRead(0), spillWritten(0),
+	failure(false)
+{
+}
+
+SpillQueue::~SpillQueue()
+{
+	if (spill)
+		fclose(spill);
+}
+
+void SpillQueue::push(int64_t value)
+{
+	// Once anything has spilled, newer entries must queue up behind it
+	if (spillRead == spillWritten && pending.empty() && front.size() < limit)
+	{
+		front.push_back(value);
+		return;
+	}
+
+	pending.push_back(value);
+	if (pending.size() >= limit)
+		flush();
+}
+
+bool SpillQueue::pop(int64_t& value)
+{
+	if (front.empty())
+	{
+		// Read back the oldest spilled entries, then any that were never written
+		if (spillRead < spillWritten)
+		{
+			size_t count = std::min(limit, spillWritten - spillRead);
+			std::vector<int64_t> block(count);
+			fseek(spill, spillRead * sizeof(int64_t), SEEK_SET);
+			if (fread(&block[0], sizeof(int64_t), count, spill) != count)
+			{
+				std::cerr << "Could not read spilled queue entries\n";
+				failure = true;
+				clear();
+				return false;
+			}
+			spillRead += count;
+			front.insert(front.end(), block.begin(), block.end());
+		}
+		else if (!pending.empty())
+		{
+			front.insert(front.end(), pending.begin(), pending.end());
+			pending.clear();
+		}
+
+		if (spillRead == spillWritten)
+			spillRead = spillWritten = 0;
+		if (front.empty())
+			return false;
+	}
+
+	value = front.front();
+	front.pop_front();
+	return true;
+}
+
+void SpillQueue::clear()
+{
+	front.clear();
+	pending.clear();
+	spillRead = spillWritten = 0;
+}
+
+void SpillQueue::flush()
+{
+	if (!spill)
+		spill = tmpfile();
+	if (!spill)
+	{
+		std::cerr << "Could not create a scratch file for the search queue\n";
+		failure = true;
+		pending.clear();
+		return;
+	}
+
+	fseek(spill, spillWritten * sizeof(int64_t), SEEK_SET);
+	if (fwrite(&pending[0], sizeof(int64_t), pending.size(), spill) != pending.size())
+	{
+		std::cerr << "Could not spill queue entries\n";
+		failure = true;
+		pending.clear();
+		return;
+	}
+	spillWritten += pending.size();
+	pending.clear();
+}
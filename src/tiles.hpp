@@ -0,0 +1,140 @@
+/*
+	@brief Disk-backed storage for the residual network of images too large to hold in memory.
+	@author Drew Guarnera, Bharath Bogadamidi, Heather Michaud
+	@version 0.9
+	@copyright Copyright 2014 Guarnera, Bogadamidi, Michaud. All rights reserved.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <deque>
+#include <list>
+#include <vector>
+
+//! @brief Residual network state of one pixel, as stored in a TileStore
+/*
+	@note Both directions of an n-link share one arc pair, so cap[LEFT] of a pixel and cap[RIGHT] of its left neighbor
+	 are the residual capacities of the same link. The reverse arcs of the t-links are never used by a search from
+	 the source and are not stored.
+*/
+struct tilePixel
+{
+	int32_t cap[4];		//! Residual capacity to the left, right, top and bottom neighbors (Pgm::PixelArc order)
+	int32_t source;		//! Residual capacity from the source
+	int32_t sink;		//! Residual capacity to the sink
+	uint32_t visit;		//! Search that last visited this pixel, or 0 for none since the numbers last wrapped
+	uint16_t value;		//! Pixel value
+	uint8_t parent;		//! Direction of the neighbor this pixel was reached from
+	uint8_t flags;		//! DEAD once no path to the sink is left
+};
+
+//! @brief Pixel grid kept in a scratch file and mapped into memory in bands of rows (tiles). Only a bounded number
+//!	 of tiles is mapped at a time; the least recently used tile is unmapped to make room for another.
+class TileStore
+{
+	public:
+		static const uint8_t DEAD = 1;	//!< tilePixel flag: the pixel cannot reach the sink
+
+		//! @brief Basic constructor
+		TileStore();
+
+		//! @brief Basic destructor. Unmaps every tile and closes the scratch file.
+		~TileStore();
+
+		//! @brief Creates the scratch file for an image and sizes the tiles to fit a memory budget
+		//! @param width Image width
+		//! @param height Image height
+		//! @param budget Bytes of tiles that may be mapped at once. At least three tiles of one row are always allowed.
+		//! @param directory Directory for the scratch file, which is removed as soon as it is created
+		//! @retval true if successful, false otherwise
+		bool create(int width, int height, size_t budget, const char* directory);
+
+		//! @brief Gets a pixel, mapping its tile if needed. The reference stays valid until two other tiles have been
+		//!	 used after it. If the tile cannot be mapped, failed is set and the pixel returned is scratch space.
+		//! @param xPos Column
+		//! @param yPos Row
+		//! @retval The pixel's state
+		tilePixel& at(int xPos, int yPos)
+		{
+			int tile = yPos / tileRows;
+			if (tile != lastTile)
+				use(tile);
+			return lastPixels[(static_cast<size_t>(yPos - (tile * tileRows)) * width) + xPos];
+		}
+
+		int width;				//!< Image width
+		int height;				//!< Image height
+		int tileRows;			//!< Rows in each tile
+		int tiles;				//!< Number of tiles
+		size_t maxResident;		//!< Most tiles mapped at once
+		size_t tileLoads;		//!< Number of times a tile has been mapped
+		bool failed;			//!< Set once a tile could not be mapped. Pixels read from then on are not the image's.
+
+	private:
+		//! @brief Makes a tile the most recently used, mapping it if needed
+		void use(int tile);
+
+		//! @brief A mapped tile
+		struct residentTile
+		{
+			tilePixel* pixels;					//! First pixel of the tile, or NULL if not mapped
+			void* mapping;						//! Start of the page-aligned mapping
+			size_t mappingSize;					//! Length of the mapping
+			std::list<int>::iterator recent;	//! Position in the least recently used list
+		};
+
+		int fd;									//!< Scratch file
+		std::vector<residentTile> slots;		//!< One per tile
+		std::list<int> recentTiles;				//!< Mapped tiles, most recently used first
+		int lastTile;							//!< Tile of the last pixel returned
+		tilePixel* lastPixels;					//!< First pixel of lastTile
+		std::vector<tilePixel> fallback;		//!< Stands in for tiles that could not be mapped
+
+		TileStore(const TileStore&);
+		TileStore& operator=(const TileStore&);
+};
+
+//! @brief First-in first-out queue of pixel positions that keeps a bounded number of entries in memory and spills the
+//!	 rest to a scratch file
+class SpillQueue
+{
+	public:
+		//! @brief Basic constructor
+		//! @param limit Entries kept in memory before spilling
+		SpillQueue(size_t limit);
+
+		//! @brief Basic destructor. Closes the scratch file.
+		~SpillQueue();
+
+		//! @brief Adds an entry at the back of the queue
+		void push(int64_t value);
+
+		//! @brief Removes the entry at the front of the queue
+		//! @param value Set to the entry removed
+		//! @retval false if the queue was empty
+		bool pop(int64_t& value);
+
+		//! @brief Removes every entry
+		void clear();
+
+		//! @brief Checks whether the scratch file could not be written or read. Entries may have been lost since.
+		bool failed() const { return failure; }
+
+	private:
+		//! @brief Writes the pending spilled entries to the scratch file
+		void flush();
+
+		size_t limit;					//!< Entries kept in memory
+		std::deque<int64_t> front;		//!< Oldest entries, in memory
+		std::vector<int64_t> pending;	//!< Newest spilled entries, not yet written
+		FILE* spill;					//!< Scratch file, created on first spill
+		size_t spillRead;				//!< Entries read back from the scratch file
+		size_t spillWritten;			//!< Entries written to the scratch file
+		bool failure;					//!< Set once the scratch file could not be used
+
+		SpillQueue(const SpillQueue&);
+		SpillQueue& operator=(const SpillQueue&);
+};
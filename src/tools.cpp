@@ -3,6 +3,9 @@
 */
 
 #include "tools.hpp"
+#include "tiles.hpp"
+#include "cache.hpp"
+#include "queue.hpp"
 #include <stdint.h>
 #include <limits>
 #include <queue>
@@ -10,6 +13,560 @@
 #include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace
+{
+	//! @brief Finds the neighbor of a pixel in one of the n-link directions
+	//! @retval false if the neighbor is outside the image
+	bool neighborOf(const TileStore& store, int xPos, int yPos, int direction, int& xNext, int& yNext)
+	{
+		xNext = xPos + ((direction == Pgm::LEFT) ? -1 : (direction == Pgm::RIGHT) ? 1 : 0);
+		yNext = yPos + ((direction == Pgm::TOP) ? -1 : (direction == Pgm::BOTTOM) ? 1 : 0);
+		return xNext >= 0 && xNext < store.width && yNext >= 0 && yNext < store.height;
+	}
+
+	//! @brief The n-link direction pointing back the way a direction came (left and right, top and bottom)
+	int opposite(int direction)
+	{
+		return direction ^ 1;
+	}
+
+	//! @brief Numbers a new search in a TileStore. When the 32 bit numbers run out, every pixel's visit stamp is
+	//!	 cleared and numbering starts again, so that a stamp left by an old search never matches a new one.
+	//! @param store The pixel grid
+	//! @param epoch Number of the last search, advanced to the new one
+	//! @retval The number of the new search
+	uint32_t nextEpoch(TileStore& store, uint32_t& epoch)
+	{
+		if (epoch == std::numeric_limits<uint32_t>::max())
+		{
+			for (int yPos = 0; yPos < store.height; ++yPos)
+				for (int xPos = 0; xPos < store.width; ++xPos)
+					store.at(xPos, yPos).visit = 0;
+			epoch = 0;
+		}
+		return ++epoch;
+	}
+
+	//! @brief Sends flow from one pixel's source link to another pixel's sink link along the path of a search
+	//! @param store The pixel grid, with each pixel on the path pointing at the one before it
+	//! @param xStart, yStart The pixel whose source capacity is sent
+	//! @param xEnd, yEnd The pixel whose sink capacity receives it
+	//! @param maxFlow Increased by the flow sent
+	//! @retval true if any flow was sent, false if a link on the path is already saturated
+	bool sendTiled(TileStore& store, int xStart, int yStart, int xEnd, int yEnd, int64_t& maxFlow)
+	{
+		// Find the minimum residual capacity along the path, then move it onto the reverse direction of each link
+		int32_t minCapacity = std::min(store.at(xStart, yStart).source, store.at(xEnd, yEnd).sink);
+		for (int pass = 0; pass < 2 && minCapacity > 0; ++pass)
+		{
+			int xPos = xEnd, yPos = yEnd;
+			while (xPos != xStart || yPos != yStart)
+			{
+				int back = store.at(xPos, yPos).parent;
+				int xPrev, yPrev;
+				neighborOf(store, xPos, yPos, back, xPrev, yPrev);
+				tilePixel& previous = store.at(xPrev, yPrev);
+				if (pass == 0)
+					minCapacity = std::min(minCapacity, previous.cap[opposite(back)]);
+				else
+				{
+					previous.cap[opposite(back)] -= minCapacity;
+					store.at(xPos, yPos).cap[back] += minCapacity;
+				}
+				xPos = xPrev;
+				yPos = yPrev;
+			}
+		}
+		if (minCapacity <= 0)
+			return false;
+
+		store.at(xStart, yStart).source -= minCapacity;
+		store.at(xEnd, yEnd).sink -= minCapacity;
+		maxFlow += minCapacity;
+		return true;
+	}
+
+	//! @brief Sends flow from one pixel's source link to the sink along shortest residual paths in a TileStore. A
+	//!	 single breadth first search from the pixel sends flow to each pixel with sink capacity as it reaches it, so
+	//!	 one search can fill many paths; it stops once the pixel's source capacity is used up.
+	//! @param store The pixel grid
+	//! @param queue Scratch queue for the search
+	//! @param xStart, yStart The pixel whose source capacity is sent
+	//! @param epoch Number of this search, from nextEpoch
+	//! @param limit Most pixels the search may visit, or 0 for no limit
+	//! @param maxFlow Increased by the flow sent
+	//! @retval true if any flow was sent. An unlimited search that sends nothing proves the pixel cannot reach the
+	//!	 sink.
+	bool augmentTiled(TileStore& store, SpillQueue& queue, int xStart, int yStart, uint32_t epoch, size_t limit,
+		int64_t& maxFlow)
+	{
+		queue.clear();
+		queue.push((static_cast<int64_t>(yStart) * store.width) + xStart);
+		store.at(xStart, yStart).visit = epoch;
+
+		bool sent = false;
+		size_t visited = 0;
+		int64_t position;
+		while (queue.pop(position))
+		{
+			int xPos = position % store.width;
+			int yPos = position / store.width;
+			// Carry on only while every link of the search tree still has capacity: that is, when the pixel reached
+			// rather than a link limited the flow sent
+			if (store.at(xPos, yPos).sink > 0)
+			{
+				if (!sendTiled(store, xStart, yStart, xPos, yPos, maxFlow))
+					break;
+				sent = true;
+				if (store.at(xStart, yStart).source <= 0 || store.at(xPos, yPos).sink > 0)
+					break;
+			}
+			if (limit > 0 && ++visited >= limit)
+				break;
+
+			// Fetched again, since sending flow may have moved the tiles around
+			tilePixel& current = store.at(xPos, yPos);
+			for (int direction = Pgm::LEFT; direction <= Pgm::BOTTOM; ++direction)
+			{
+				int xNext, yNext;
+				if (current.cap[direction] <= 0 || !neighborOf(store, xPos, yPos, direction, xNext, yNext))
+					continue;
+				tilePixel& next = store.at(xNext, yNext);
+				if (next.visit != epoch && !(next.flags & TileStore::DEAD))
+				{
+					next.visit  = epoch;
+					next.parent = opposite(direction);
+					queue.push((static_cast<int64_t>(yNext) * store.width) + xNext);
+				}
+			}
+		}
+		return sent;
+	}
+
+	//! @brief Marks every pixel reachable from a pixel in the residual grid as unable to reach the sink
+	void markDead(TileStore& store, SpillQueue& queue, int xStart, int yStart)
+	{
+		queue.clear();
+		queue.push((static_cast<int64_t>(yStart) * store.width) + xStart);
+		store.at(xStart, yStart).flags |= TileStore::DEAD;
+
+		int64_t position;
+		while (queue.pop(position))
+		{
+			int xPos = position % store.width;
+			int yPos = position / store.width;
+			for (int direction = Pgm::LEFT; direction <= Pgm::BOTTOM; ++direction)
+			{
+				int xNext, yNext;
+				if (store.at(xPos, yPos).cap[direction] <= 0
+					|| !neighborOf(store, xPos, yPos, direction, xNext, yNext))
+					continue;
+				tilePixel& next = store.at(xNext, yNext);
+				if (!(next.flags & TileStore::DEAD))
+				{
+					next.flags |= TileStore::DEAD;
+					queue.push((static_cast<int64_t>(yNext) * store.width) + xNext);
+				}
+			}
+		}
+	}
+
+	//! @brief Work shared by the threads that solve the components of an image
+	struct componentJobs
+	{
+		Pgm* image;							//! The image, with its components found
+		const Tools::segmentOptions* options;	//! How to solve each component
+		const Tools::Deadline* deadline;	//! When to stop augmenting, or NULL
+		const std::vector<int32_t>* start;	//! First pixel of each component, as found by Pgm::findComponents
+		const std::vector<int32_t>* pixels;	//! Pixels of every component
+		std::vector<int32_t> order;			//! Components of more than one pixel, largest first
+		std::atomic<size_t> next;			//! Position in order of the next component to solve
+		std::vector<uint8_t> foreground;	//! By raster index. Bytes rather than bits, so threads can write side by side.
+	};
+
+	//! @brief Orders components from the largest to the smallest
+	struct largerComponent
+	{
+		const std::vector<int32_t>* start;	//! First pixel of each component
+
+		bool operator()(int32_t a, int32_t b) const
+		{
+			return ((*start)[a + 1] - (*start)[a]) > ((*start)[b + 1] - (*start)[b]);
+		}
+	};
+
+	//! @brief Takes components from the shared list and solves each in a network of its own until none are left
+	template<typename Cap, typename Index>
+	struct componentSolver
+	{
+		componentJobs* jobs;						//! The shared work
+		std::vector<Index>* localID;				//! Node of each pixel in its component's network
+		typename Tools::FlowTotal<Cap>::type* flow;	//! Set to the flow through the components this thread solved
+		typename Tools::FlowTotal<Cap>::type* bound;	//! Set to the capacity of their cuts
+
+		void operator()() const
+		{
+			// The network and search buffers grow to the largest component this thread takes, which is its first
+			FlowNetwork<Cap, Index> network;
+			Tools::FlowWorkspace<Index> workspace;
+			std::vector<bool> sourceSide;
+			const Tools::segmentOptions& options = *jobs->options;
+			*flow = *bound = 0;
+
+			for (size_t job = jobs->next++; job < jobs->order.size(); job = jobs->next++)
+			{
+				int32_t component = jobs->order[job];
+				const int32_t* pixels = &(*jobs->pixels)[(*jobs->start)[component]];
+				Index count = (*jobs->start)[component + 1] - (*jobs->start)[component];
+				jobs->image->addComponent(network, pixels, count, *localID);
+
+				// Once time has run out, the components left only get the cut their empty flow gives
+				if (!jobs->deadline || std::chrono::steady_clock::now() < *jobs->deadline)
+				{
+					typename Tools::FlowTotal<Cap>::type initialFlow = 0;
+					if (options.warmStart)
+						initialFlow = Tools::greedyFlow(network, network.source, network.sink, options.searchLimit,
+							jobs->deadline, workspace);
+					*flow += Tools::fordFulkerson(network, network.source, network.sink, initialFlow, jobs->deadline,
+						workspace);
+				}
+				*bound += Tools::boundingCut(network, network.source, network.sink, sourceSide, workspace);
+
+				for (Index p = 0; p < count; ++p)
+					jobs->foreground[pixels[p]] = sourceSide[p];
+			}
+		}
+	};
+
+	//! @brief Segments a loaded image by solving each connected component of its pixels separately, in parallel.
+	//!	 Single pixels are solved directly: the flow through them is the smaller of their two t-links, and they
+	//!	 belong to the foreground if the link from the source is the larger.
+	//! @param p The image, with its threshold calculated
+	//! @param options How to solve the components
+	//! @param deadline When to stop augmenting, if the options have a time budget
+	//! @param foreground Filled with true for every pixel node on the source side of the cut
+	//! @param totalFlow Set to the flow found
+	//! @param totalBound Set to the capacity of the cut, which is above the flow only if time ran out
+	template<typename Cap, typename Index>
+	void segmentComponents(Pgm& p, const Tools::segmentOptions& options, const Tools::Deadline& deadline,
+		std::vector<bool>& foreground, int64_t& totalFlow, int64_t& totalBound)
+	{
+		std::vector<int32_t> start, pixels;
+		int32_t components = p.findComponents(start, pixels);
+
+		componentJobs jobs;
+		jobs.image    = &p;
+		jobs.options  = &options;
+		jobs.deadline = (options.timeBudget > 0) ? &deadline : NULL;
+		jobs.start    = &start;
+		jobs.pixels   = &pixels;
+		jobs.next     = 0;
+		jobs.foreground.assign(pixels.size(), 0);
+
+		typename Tools::FlowTotal<Cap>::type maxFlow = 0;
+		typename Tools::FlowTotal<Cap>::type bound = 0;
+		for (int32_t component = 0; component < components; ++component)
+		{
+			if (start[component + 1] - start[component] > 1)
+			{
+				jobs.order.push_back(component);
+				continue;
+			}
+
+			int32_t pixel = pixels[start[component]];
+			int sourceWeight, sinkWeight;
+			p.terminalWeights(pixel % p.xMax, pixel / p.xMax, sourceWeight, sinkWeight);
+			maxFlow += std::min(sourceWeight, sinkWeight);
+			bound   += std::min(sourceWeight, sinkWeight);
+			jobs.foreground[pixel] = sourceWeight > sinkWeight;
+		}
+		largerComponent larger = { &start };
+		std::sort(jobs.order.begin(), jobs.order.end(), larger);
+
+		// One thread per core, but no more threads than components
+		size_t threads = (options.threads > 0) ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+		threads = std::max<size_t>(1, std::min(threads, jobs.order.size()));
+		std::vector<Index> localID(pixels.size());
+		std::vector<typename Tools::FlowTotal<Cap>::type> flows(threads), bounds(threads);
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < threads; ++i)
+		{
+			componentSolver<Cap, Index> solver = { &jobs, &localID, &flows[i], &bounds[i] };
+			if (i + 1 < threads)
+				workers.push_back(std::thread(solver));
+			else
+				solver();
+		}
+		for (size_t i = 0; i < workers.size(); ++i)
+			workers[i].join();
+		for (size_t i = 0; i < threads; ++i)
+		{
+			maxFlow += flows[i];
+			bound   += bounds[i];
+		}
+
+		totalFlow  = maxFlow;
+		totalBound = bound;
+
+		foreground.assign(pixels.size(), false);
+		for (int yPos = 0; yPos < p.yMax; ++yPos)
+			for (int xPos = 0; xPos < p.xMax; ++xPos)
+				foreground[p.nodeID(xPos, yPos)] = jobs.foreground[(p.xMax * yPos) + xPos];
+	}
+
+	//! @brief Segments a loaded image using a network of the given capacity and index types
+	//! @param p The image, with its threshold calculated
+	//! @param options How to solve the network
+	//! @param deadline When to stop augmenting, if the options have a time budget
+	//! @param foreground Filled with true for every pixel node on the source side of the cut
+	//! @param totalFlow Set to the flow found
+	//! @param totalBound Set to the capacity of the cut, which is above the flow only if time ran out
+	template<typename Cap, typename Index>
+	void segmentPgm(Pgm& p, const Tools::segmentOptions& options, const Tools::Deadline& deadline,
+		std::vector<bool>& foreground, int64_t& totalFlow, int64_t& totalBound)
+	{
+		if (options.components && (static_cast<int64_t>(p.xMax) * p.yMax) < INT32_MAX)
+		{
+			segmentComponents<Cap, Index>(p, options, deadline, foreground, totalFlow, totalBound);
+			return;
+		}
+
+		FlowNetwork<Cap, Index> network;
+		p.addPaths(network);
+		p.addSuperNodes(network);
+
+		// Saturate the short paths around each pixel, then run Ford Fulkerson on the pgm graph from that flow
+		const Tools::Deadline* stop = (options.timeBudget > 0) ? &deadline : NULL;
+		typename Tools::FlowTotal<Cap>::type initialFlow = 0;
+		if (options.warmStart)
+			initialFlow = Tools::greedyFlow(network, network.source, network.sink, options.searchLimit, stop);
+		typename Tools::FlowTotal<Cap>::type maxFlow = Tools::fordFulkerson(network, network.source, network.sink,
+			initialFlow, stop);
+
+		// Pixels still reachable from the source after the flow is maximal form the foreground. If time ran out first,
+		// the cut is the best one the current flow gives, and its capacity bounds how far the flow was from maximal.
+		totalFlow  = maxFlow;
+		totalBound = Tools::boundingCut(network, network.source, network.sink, foreground);
+	}
+
+	//! @brief Solves the network of the flat regions of an image using the given capacity and index types
+	//! @param p The image
+	//! @param regions The flat regions of the image
+	//! @param options How to solve the network
+	//! @param deadline When to stop augmenting, if the options have a time budget
+	//! @param sourceSide Filled with true for every region on the source side of the cut
+	//! @param totalFlow Set to the flow found
+	//! @param totalBound Set to the capacity of the cut, which is above the flow only if time ran out
+	template<typename Cap, typename Index>
+	void solveRegions(Pgm& p, const flatRegions& regions, const Tools::segmentOptions& options,
+		const Tools::Deadline& deadline, std::vector<bool>& sourceSide, int64_t& totalFlow, int64_t& totalBound)
+	{
+		FlowNetwork<Cap, Index> network;
+		p.addRegions(network, regions);
+
+		const Tools::Deadline* stop = (options.timeBudget > 0) ? &deadline : NULL;
+		typename Tools::FlowTotal<Cap>::type initialFlow = 0;
+		if (options.warmStart)
+			initialFlow = Tools::greedyFlow(network, network.source, network.sink, options.searchLimit, stop);
+		totalFlow  = Tools::fordFulkerson(network, network.source, network.sink, initialFlow, stop);
+		totalBound = Tools::boundingCut(network, network.source, network.sink, sourceSide);
+	}
+
+	//! @brief Segments a loaded image in a network with one node per flat region rather than one per pixel, then
+	//!	 gives every pixel the side of its region
+	//! @param p The image, with its threshold calculated
+	//! @param options How to find the regions and solve the network
+	//! @param deadline When to stop augmenting, if the options have a time budget
+	//! @param foreground Filled with true for every pixel node on the source side of the cut
+	//! @param totalFlow Set to the flow found
+	//! @param totalBound Set to the capacity of the cut, which is above the flow only if time ran out
+	void segmentRegions(Pgm& p, const Tools::segmentOptions& options, const Tools::Deadline& deadline,
+		std::vector<bool>& foreground, int64_t& totalFlow, int64_t& totalBound)
+	{
+		flatRegions regions;
+		int32_t count = p.findRegions(options.flatTolerance, regions);
+
+		// A region's links add up the links of all its pixels, so the capacity type is picked from the largest sum
+		int64_t largest = 0;
+		for (int32_t r = 0; r < count; ++r)
+			largest = std::max(largest, std::max(regions.source[r], regions.sink[r]));
+		for (size_t i = 0; i < regions.weight.size(); ++i)
+			largest = std::max(largest, regions.weight[i]);
+		int64_t maxResidual = 2 * largest;
+		bool narrowIndex = (static_cast<int64_t>(regions.neighbor.size()) + (4 * static_cast<int64_t>(count)))
+			< INT32_MAX;
+
+		std::vector<bool> side;
+		if (maxResidual <= INT16_MAX)
+			narrowIndex ? solveRegions<int16_t, int32_t>(p, regions, options, deadline, side, totalFlow, totalBound)
+				: solveRegions<int16_t, int64_t>(p, regions, options, deadline, side, totalFlow, totalBound);
+		else if (maxResidual <= INT32_MAX)
+			narrowIndex ? solveRegions<int32_t, int32_t>(p, regions, options, deadline, side, totalFlow, totalBound)
+				: solveRegions<int32_t, int64_t>(p, regions, options, deadline, side, totalFlow, totalBound);
+		else
+			narrowIndex ? solveRegions<int64_t, int32_t>(p, regions, options, deadline, side, totalFlow, totalBound)
+				: solveRegions<int64_t, int64_t>(p, regions, options, deadline, side, totalFlow, totalBound);
+
+		foreground.assign(regions.label.size(), false);
+		for (int yPos = 0; yPos < p.yMax; ++yPos)
+			for (int xPos = 0; xPos < p.xMax; ++xPos)
+				foreground[p.nodeID(xPos, yPos)] = side[regions.label[(p.xMax * yPos) + xPos]];
+	}
+
+	//! @brief Hashes everything that decides the cut of an image: its pixels and size, the threshold, the weight
+	//!	 function and the flat region tolerance. The layout, warm start and component options change how the cut is
+	//!	 found but not the cut, since the foreground is always the set of pixels the source reaches once the flow is
+	//!	 maximal.
+	//! @param p The image, with its threshold calculated
+	//! @param options The settings the cut is found with
+	//! @retval The cache key
+	std::string cacheKey(const Pgm& p, const Tools::segmentOptions& options)
+	{
+		ContentHash hash;
+		hash.add(static_cast<int64_t>(ResultCache::VERSION));
+		hash.add(static_cast<int64_t>(Pgm::ARCS_PER_PIXEL - 2));	// Neighbors linked to each pixel
+		hash.add(static_cast<int64_t>(p.xMax));
+		hash.add(static_cast<int64_t>(p.yMax));
+		hash.add(static_cast<int64_t>(p.pixMax));
+		hash.add(static_cast<int64_t>(p.threshold));
+		hash.add(static_cast<int64_t>(p.weight));
+		if (p.weight == WeightTable::GAUSSIAN)
+			hash.add(&p.sigma, sizeof(p.sigma));
+		if (options.mergeFlat)
+			hash.add(static_cast<int64_t>(options.flatTolerance));
+		for (int xPos = 0; xPos < p.xMax; ++xPos)
+			hash.add(p.matrix[xPos], sizeof(int) * p.yMax);
+		return hash.hex();
+	}
+
+	//! @brief Segments a loaded image, from the cache if it holds the result
+	//! @param p The image
+	//! @param options How to build and solve the network
+	//! @param deadline When to stop augmenting, if the options have a time budget
+	//! @param foreground Filled with true for every pixel node on the source side of the cut
+	void segmentLoaded(Pgm& p, const Tools::segmentOptions& options, const Tools::Deadline& deadline,
+		std::vector<bool>& foreground)
+	{
+		p.layout = options.layout;
+		p.weight = options.weight;
+		p.sigma  = options.sigma;
+		p.threads = options.threads;
+
+		p.calculateThreshold();
+
+		// A cached result for the same pixels and settings is used without building a network
+		ResultCache cache;
+		std::string key;
+		int64_t maxFlow = 0;
+		int64_t bound = 0;
+		bool cached = options.cacheDirectory && cache.open(options.cacheDirectory, options.cacheBytes);
+		if (cached)
+		{
+			key = cacheKey(p, options);
+			std::vector<bool> raster;
+			if (cache.find(key, p.xMax, p.yMax, raster, maxFlow))
+			{
+				foreground.resize(raster.size());
+				for (int yPos = 0; yPos < p.yMax; ++yPos)
+					for (int xPos = 0; xPos < p.xMax; ++xPos)
+						foreground[p.nodeID(xPos, yPos)] = raster[(static_cast<int64_t>(p.xMax) * yPos) + xPos];
+				return;
+			}
+		}
+
+		// Pick the narrowest network that cannot overflow. Both directions of an n-link share one arc pair, so a
+		// residual capacity can reach twice the largest pixel value.
+		int64_t maxResidual = 2 * static_cast<int64_t>(p.pixMax);
+		bool narrowIndex = Pgm::networkArcs(static_cast<int64_t>(p.xMax) * p.yMax) < INT32_MAX;
+		// Flat regions are solved in a network of their own, sized by the sums of their links
+		if (options.mergeFlat && (static_cast<int64_t>(p.xMax) * p.yMax) < INT32_MAX)
+			segmentRegions(p, options, deadline, foreground, maxFlow, bound);
+		else if (maxResidual <= INT16_MAX)
+			narrowIndex ? segmentPgm<int16_t, int32_t>(p, options, deadline, foreground, maxFlow, bound)
+				: segmentPgm<int16_t, int64_t>(p, options, deadline, foreground, maxFlow, bound);
+		else if (maxResidual <= INT32_MAX)
+			narrowIndex ? segmentPgm<int32_t, int32_t>(p, options, deadline, foreground, maxFlow, bound)
+				: segmentPgm<int32_t, int64_t>(p, options, deadline, foreground, maxFlow, bound);
+		else
+			narrowIndex ? segmentPgm<int64_t, int32_t>(p, options, deadline, foreground, maxFlow, bound)
+				: segmentPgm<int64_t, int64_t>(p, options, deadline, foreground, maxFlow, bound);
+
+		// Only maximal flows are cached. A cut written when the time budget ran out depends on how far the solver got.
+		if (bound > maxFlow)
+			std::cerr << "Time budget reached with a flow of " << maxFlow << " and a cut of " << bound << " (gap "
+				<< (bound - maxFlow) << ", " << ((100.0 * (bound - maxFlow)) / bound) << "%)\n";
+		else if (cached)
+		{
+			std::vector<bool> raster(foreground.size());
+			for (int yPos = 0; yPos < p.yMax; ++yPos)
+				for (int xPos = 0; xPos < p.xMax; ++xPos)
+					raster[(static_cast<int64_t>(p.xMax) * yPos) + xPos] = foreground[p.nodeID(xPos, yPos)];
+			cache.store(key, p.xMax, p.yMax, raster, maxFlow);
+		}
+	}
+
+	//! @brief An image passing through the stages of segmentStream. A NULL image marks the end of the stream.
+	struct streamImage
+	{
+		Pgm* image;						//! The pixels, owned by whichever stage holds the item
+		std::vector<bool> foreground;	//! The cut, once solved
+	};
+
+	//! @brief First stage of segmentStream: parses images from the input until it ends or holds something that is
+	//!	 not an image
+	struct streamParser
+	{
+		std::istream* input;				//! Concatenated images
+		BoundedQueue<streamImage*>* parsed;	//! Images waiting to be solved
+		bool* failed;						//! Set if the input holds anything after the last whole image
+
+		void operator()()
+		{
+			PgmReader reader;
+			while (true)
+			{
+				*input >> std::ws;
+				if (input->peek() == std::char_traits<char>::eof())
+					break;
+
+				streamImage* item = new streamImage;
+				item->image = new Pgm;
+				if (!reader.open(*input, "image stream") || !item->image->fromReader(reader))
+				{
+					delete item->image;
+					delete item;
+					*failed = true;
+					break;
+				}
+				parsed->push(item);
+			}
+			parsed->push(NULL);
+		}
+	};
+
+	//! @brief Last stage of segmentStream: writes the cuts in the order they are solved
+	struct streamEncoder
+	{
+		std::ostream* output;				//! Where the cuts go
+		BoundedQueue<streamImage*>* solved;	//! Cuts waiting to be written
+		bool* failed;						//! Set if the output could not be written
+
+		void operator()()
+		{
+			// Cuts are still taken off the queue after a failure, so that the solver never waits on a full queue
+			for (streamImage* item = solved->pop(); item; item = solved->pop())
+			{
+				if (!*failed && !(item->image->write(*output, item->foreground) && output->flush()))
+					*failed = true;
+				delete item->image;
+				delete item;
+			}
+		}
+	};
+}
 
 namespace Tools 
 {
@@ -43,10 +600,8 @@ namespace Tools
 		input.close();
 	}
 
-	//! @note Right now this is taking only one end vertex. If we want to enable multiple end vertices, we could still
-	//!	 keep essentially the same algorithm but consider the last vertex to be the maximum of all listed end vertices.
-	//!	 For each given end vertex, we would reverse iterate through the list of preceding nodes. We would then have a 
-	//!	 list of a list of the shortest paths to each given end vertex, for each given end vertex.
+	//! @note This takes only one end vertex. searchTree (flow.hpp) finds the paths from one start to many end vertices
+	//!	 of a FlowNetwork in a single search, back-tracking from each end vertex through the preceding nodes.
 	std::pair< std::vector<int>, int> breadthFirstSearch(Graph& g, int start, int end)
 	{
 		static int infinity = std::numeric_limits<int>::max();
@@ -181,25 +736,157 @@ namespace Tools
 		return maxFlow;
 	}
 
-	void segmentImage(const char* file, const char* cut)
+	bool segmentImage(const char* file, const char* cut, const segmentOptions& options)
 	{
+		Deadline deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeBudget);
 		Pgm p;
 
 		if (!p.fromFile(file))
-			return;
+			return false;
+		std::vector<bool> foreground;
+		segmentLoaded(p, options, deadline, foreground);
 
-		p.calculateThreshold();
-		p.addPaths();
+		// Write to output file
+		return p.write(cut, foreground);
+	}
 
-		int sourceID = -1;
-		int sinkID   = p.xMax * p.yMax;
-		p.addSuperNodes(sourceID, sinkID);
+	bool segmentImageTiled(const char* file, const char* cut, size_t budget, const char* directory,
+		const segmentOptions& options, int64_t* totalFlow)
+	{
+		PgmReader reader;
+		if (!reader.open(file))
+			return false;
 
-		// Run Ford Fulkerson on the pgm graph
-		fordFulkerson(p.g, sourceID, sinkID);
+		// A sixteenth of the budget goes to the search queue, the rest to tiles
+		TileStore store;
+		if (!store.create(reader.xMax, reader.yMax, budget - (budget / 16), directory))
+			return false;
+		SpillQueue queue((budget / 16) / sizeof(int64_t));
 
-		// Write to output file
-		p.write(cut, sourceID);
+		// Stream the pixels into the store, adding them up for the threshold
+		std::vector<int> row;
+		int64_t nodeSum = 0;
+		for (int yPos = 0; yPos < reader.yMax; ++yPos)
+		{
+			if (!reader.readRow(row))
+			{
+				std::cerr << "Image ended early: " << file << "\n";
+				return false;
+			}
+			for (int xPos = 0; xPos < reader.xMax; ++xPos)
+			{
+				tilePixel& pixel = store.at(xPos, yPos);
+				memset(&pixel, 0, sizeof(pixel));
+				pixel.value = std::min(std::max(row[xPos], 0), reader.pixMax);
+				nodeSum += pixel.value;
+			}
+		}
+		int pixMax = reader.pixMax;
+		int64_t pixels = static_cast<int64_t>(reader.xMax) * reader.yMax;
+		int threshold = std::abs( pixMax - static_cast<int>(nodeSum / pixels) );
+		WeightTable weights;
+		weights.build(options.weight, pixMax, threshold, options.sigma);
+
+		// Set the link capacities from the same table as Pgm::addPaths and Pgm::addSuperNodes, and push the flow that
+		// can go straight from the source to the sink through each pixel
+		int64_t maxFlow = 0;
+		for (int yPos = 0; yPos < store.height; ++yPos)
+		{
+			for (int xPos = 0; xPos < store.width; ++xPos)
+			{
+				tilePixel& pixel = store.at(xPos, yPos);
+				for (int direction = Pgm::LEFT; direction <= Pgm::BOTTOM; ++direction)
+				{
+					int xNext, yNext;
+					if (!neighborOf(store, xPos, yPos, direction, xNext, yNext))
+						continue;
+					pixel.cap[direction] = weights.link(store.at(xNext, yNext).value, pixel.value);
+				}
+
+				pixel.source = weights.source(pixel.value);
+				pixel.sink   = weights.sink(pixel.value);
+
+				int32_t direct = std::min(pixel.source, pixel.sink);
+				pixel.source -= direct;
+				pixel.sink   -= direct;
+				maxFlow += direct;
+			}
+		}
+		if (store.failed)
+			return false;
+
+		// As the warm start of segmentImage does, first send flow along the short paths around each pixel, so that no
+		// pixel takes the sink capacity near another that it could have found further away
+		uint32_t epoch = 0;
+		if (options.warmStart && options.searchLimit > 0)
+		{
+			for (int yPos = 0; yPos < store.height; ++yPos)
+			{
+				for (int xPos = 0; xPos < store.width; ++xPos)
+					if (store.at(xPos, yPos).source > 0)
+						augmentTiled(store, queue, xPos, yPos, nextEpoch(store, epoch), options.searchLimit, maxFlow);
+				if (store.failed || queue.failed())
+					return false;
+			}
+		}
+
+		// Send the remaining source capacity of each pixel to the sink, until it is used up or cut off
+		for (int yPos = 0; yPos < store.height; ++yPos)
+		{
+			for (int xPos = 0; xPos < store.width; ++xPos)
+			{
+				while (store.at(xPos, yPos).source > 0 && !(store.at(xPos, yPos).flags & TileStore::DEAD))
+				{
+					if (!augmentTiled(store, queue, xPos, yPos, nextEpoch(store, epoch), 0, maxFlow))
+						markDead(store, queue, xPos, yPos);
+				}
+			}
+
+			// The scratch files report their own errors; a search that lost pixels or entries cannot be trusted
+			if (store.failed || queue.failed())
+				return false;
+		}
+
+		if (totalFlow)
+			*totalFlow = maxFlow;
+
+		// Pixels cut off from the sink are the ones still reachable from the source: the foreground
+		PgmWriter writer;
+		if (!writer.open(cut, store.width, store.height, pixMax))
+			return false;
+		for (int yPos = 0; yPos < store.height; ++yPos)
+		{
+			for (int xPos = 0; xPos < store.width; ++xPos)
+			{
+				const tilePixel& pixel = store.at(xPos, yPos);
+				row[xPos] = (pixel.flags & TileStore::DEAD) ? pixel.value : pixMax;
+			}
+			writer.writeRow(row);
+		}
+		return writer.close() && !store.failed;
 	}
-}
 
+	bool segmentStream(std::istream& input, std::ostream& output, const segmentOptions& options, size_t depth)
+	{
+		BoundedQueue<streamImage*> parsed(depth), solved(depth);
+		bool parseFailed = false, encodeFailed = false;
+		streamParser parser = { &input, &parsed, &parseFailed };
+		streamEncoder encoder = { &output, &solved, &encodeFailed };
+		std::thread parsing(parser), encoding(encoder);
+
+		// Solve on this thread, handing each cut on as soon as it is found
+		for (streamImage* item = parsed.pop(); item; item = parsed.pop())
+		{
+			Deadline deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeBudget);
+			segmentLoaded(*item->image, options, deadline, item->foreground);
+			solved.push(item);
+		}
+		solved.push(NULL);
+
+		parsing.join();
+		encoding.join();
+		if (encodeFailed)
+			std::cerr << "Could not write to standard output\n";
+		return !parseFailed && !encodeFailed;
+	}
+}
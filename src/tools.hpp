@@ -8,6 +8,7 @@
 #pragma once
 
 #include "graph.hpp"
+#include "flow.hpp"
 #include "pgm.hpp"
 #include <set>
 #include <vector>
@@ -46,9 +47,76 @@ namespace Tools
 	//! @retval The maximum flow for the given graph
 	int fordFulkerson(Graph& g, int source, int sink);
 
+	//! @brief Settings for segmentImage. Apart from the weight function and flat region merging, and unless the time
+	//!	 budget runs out, the cut is the same for every setting; they only change how fast it is found.
+	struct segmentOptions
+	{
+		Pgm::NodeLayout layout;	//! Numbering of the pixel nodes. TILED and MORTON keep vertical neighbors close in memory.
+		bool warmStart;			//! Push flow along short paths with greedyFlow before running fordFulkerson
+		int searchLimit;		//! Most pixels each greedyFlow search may visit, or 0 for source -> pixel -> sink only
+
+		long timeBudget;		//! Milliseconds from the call until the best cut found so far is written, or 0 for no limit
+		WeightTable::Function weight;	//! Capacity function of the links between pixels. Changes the cut.
+		double sigma;			//! Spread of the GAUSSIAN weight function in intensity levels, or 0 for pixMax / 8
+		bool components;		//! Solve each connected component of the pixels in a network of its own
+		int threads;			//! Threads solving components at once, or building the network of the whole image, or 0
+								//!	 for one per core
+		const char* cacheDirectory;	//! Directory of cached results shared between runs, or NULL for no cache
+		uint64_t cacheBytes;	//! Most bytes of results the cache directory may hold
+		bool mergeFlat;			//! Solve a network with one node per flat region (Pgm::findRegions) instead of one per
+								//!	 pixel. Every region stays on one side, so the cut may differ where the minimum cut
+								//!	 would split a region. The components option does not apply.
+		int flatTolerance;		//! Largest difference from the first pixel of a flat region, 0 for equal pixels only
+
+		segmentOptions() : layout(Pgm::RASTER), warmStart(true), searchLimit(64), timeBudget(0),
+			weight(WeightTable::LINEAR), sigma(0), components(true), threads(0), cacheDirectory(NULL),
+			cacheBytes(256 << 20), mergeFlat(false), flatTolerance(0) {}
+	};
+
 	//! @brief Solves the image segmentation problem using ford fulkerson, separating the foreground from the background
+	//! @note The network is built with the narrowest capacity type that can hold twice the image's maximum pixel
+	//!	 value (the most an n-link can carry in either direction), and 32 bit indices unless the image is too large.
 	//! @param file The pgm image to be segmented
 	//! @param cut The specified name of the file in pgm format that will be created as a result of this function. It
 	//!	 will contain the cut foreground with a white background
-	void segmentImage(const char* file, const char* cut);
+	//! @param options How to build and solve the network
+	//! @note If the time budget runs out before the flow is maximal, the cut given by boundingCut is written instead
+	//!	 of the minimum cut, and the flow reached and the capacity of that cut are reported.
+	//! @note With a cache directory, a result already cached for the same pixels, threshold and weight function is
+	//!	 written without building the network, and every maximal result is added to the cache.
+	//! @retval true if the image was read and its cut written, false otherwise
+	bool segmentImage(const char* file, const char* cut, const segmentOptions& options = segmentOptions());
+
+	//! @brief Solves the image segmentation problem for images too large to hold in memory. The image is read in rows
+	//!	 into a TileStore on disk and the cut is written row by row, so memory use is bounded by the budget rather
+	//!	 than the size of the image.
+	//! @note The result is the same as segmentImage. Flow is first pushed straight from the source to the sink
+	//!	 through each pixel, then along the short paths found by a search of at most searchLimit pixels from each
+	//!	 pixel; then, pixel by pixel, the remaining source capacity is sent along shortest residual paths found by a
+	//!	 search that starts at that pixel and only maps the tiles it reaches. Each search keeps sending flow to the
+	//!	 pixels it reaches until a link of its tree is saturated. Once a search fails, everything it reached is
+	//!	 marked as cut off from the sink, and that set is the foreground.
+	//! @param file The pgm image to be segmented
+	//! @param cut The name of the pgm file to be created, as for segmentImage
+	//! @param budget Bytes of pixel state that may be held in memory at once
+	//! @param directory Directory for scratch files
+	//! @param options The weight function, warm start and search limit to use. The other options apply to
+	//!	 segmentImage only.
+	//! @param maxFlow If not NULL, set to the maximum flow
+	//! @retval true if successful, false otherwise
+	bool segmentImageTiled(const char* file, const char* cut, size_t budget, const char* directory,
+		const segmentOptions& options = segmentOptions(), int64_t* maxFlow = NULL);
+
+	//! @brief Segments every image of a stream of plain or raw pgm images, one after another, writing each cut to
+	//!	 the output as segmentImage writes it to a file. Parsing, solving and writing run on threads of their own, so
+	//!	 the next image is read and the last one written while the current one is solved. At most depth images wait
+	//!	 between two stages; the cuts are written in the order the images arrive.
+	//! @param input The images
+	//! @param output The cuts
+	//! @param options How to build and solve the network. The time budget applies to each image from when its
+	//!	 solve starts.
+	//! @param depth Most images waiting to be solved, and most cuts waiting to be written
+	//! @retval true if every image was read and its cut written, false otherwise
+	bool segmentStream(std::istream& input, std::ostream& output, const segmentOptions& options = segmentOptions(),
+		size_t depth = 2);
 }
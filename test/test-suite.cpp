@@ -7,6 +7,7 @@
 */
 
 #include <string.h>
+#include <math.h>
 #include <stdint.h>
 #include <assert.h>
 #include <fstream>
@@ -19,6 +20,14 @@
 #include "../src/graph.hpp"
 #include "../src/tools.hpp"
 #include "../src/pgm.hpp"
+#include "../src/segmenter.hpp"
+#include "../src/iseg.h"
+#include "../src/cache.hpp"
+#include "../src/tiles.hpp"
+#include <dirent.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
 
 const char* TEMP_GRAPH = "test/graphs/temp.txt"; // Location of temp graph file
 
@@ -345,6 +354,979 @@ void runFfUnitTests()
 	}
 }
 
+//! @brief Executes the unit tests for the flat network loaders, comparing the text and binary forms of each graph
+void runNetworkUnitTests()
+{
+	std::cerr << "Network loader tests: " << std::endl;
+	std::pair<std::string, int> maxFlowTestCases[] = {	
+				std::make_pair<std::string, int>( "test/graphs/testcase1.txt", 14 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase2.txt", 23 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase3.txt", 28 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase4.txt", 14 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase5.txt", 200 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase6.txt", 23 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase7.txt", 40 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase8.txt", 19 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase9.txt", 65 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase10.txt", 16 ) };
+	const char* binaryGraph = "test/graphs/temp.bin";
+
+	int numTestCases = 10;
+	for (int i = 0; i < numTestCases; ++i) {
+		std::cerr << maxFlowTestCases[i].first << "... ";
+
+		// Same shortest path as the adjacency list Graph
+		Graph g;
+		Tools::graphFromFile( maxFlowTestCases[i].first.c_str(), g );
+		FlowNetwork<int, int> text;
+		assert( text.fromFile( maxFlowTestCases[i].first.c_str() ) );
+		assert( text.nodes() == g.nodes() );
+		assert( Tools::breadthFirstSearch( text, 0, text.nodes() - 1 ) == Tools::breadthFirstSearch( g, 0, g.nodes() - 1 ) );
+
+		// Same max flow from the text file, and after a round trip through the binary file
+		assert( text.writeBinary( binaryGraph ) );
+		FlowNetwork<int16_t, int64_t> narrow;
+		FlowNetwork<float, int32_t> real;
+		assert( narrow.assign( text ) && real.assign( text ) );
+		int resultMaxFlow = Tools::fordFulkerson( text, text.source, text.sink );
+		FlowNetwork<int, int> binary;
+		assert( binary.load( binaryGraph ) );
+		assert( binary.nodes() == text.nodes() && binary.arcs() == text.arcs() );
+		int binaryMaxFlow = Tools::fordFulkerson( binary, binary.source, binary.sink );
+		remove( binaryGraph );
+
+		// Same max flow with other capacity and index types
+		int64_t narrowMaxFlow = Tools::fordFulkerson( narrow, narrow.source, narrow.sink );
+		double realMaxFlow = Tools::fordFulkerson( real, real.source, real.sink );
+
+		if (resultMaxFlow != maxFlowTestCases[i].second || binaryMaxFlow != maxFlowTestCases[i].second
+			|| narrowMaxFlow != maxFlowTestCases[i].second || realMaxFlow != maxFlowTestCases[i].second)
+		{
+			std::cerr << "Expected: " << maxFlowTestCases[i].second << ", Received: " << resultMaxFlow
+				<< " (text), " << binaryMaxFlow << " (binary), " << narrowMaxFlow << " (16 bit), " << realMaxFlow
+				<< " (float)\n";
+			assert( false );
+		}
+		std::cerr << std::endl;
+	}
+
+	// A binary file whose arrays or terminals do not describe a network is refused rather than solved
+	std::cerr << "corrupt binary networks... ";
+	FlowNetwork<int, int> g;
+	assert( g.fromFile( maxFlowTestCases[0].first.c_str() ) && g.writeBinary( binaryGraph ) );
+	size_t headerAt = offsetof( NetworkFile::header, source );
+	size_t firstAt  = NetworkFile::aligned( sizeof(NetworkFile::header) );
+	size_t headAt   = firstAt + NetworkFile::aligned( sizeof(int) * (g.nodes() + 1) );
+	size_t revAt    = headAt + NetworkFile::aligned( sizeof(int) * g.arcs() );
+	int64_t sourceAsSink[] = { g.sink, g.sink };
+	int64_t missingSource[] = { g.nodes(), g.sink };
+	int badFirst[] = { 1 };
+	int badLast[] = { g.arcs() + 1 };
+	int badHead[] = { g.nodes() };
+	int selfRev[] = { 0 };
+	int farRev[] = { g.arcs() };
+	int unpairedRev[] = { g.rev[1], g.rev[0] };
+
+	// Pairing two arcs of the source with each other, and their reverse arcs likewise, still pairs every arc back
+	std::vector<int> crossedRev( g.rev, g.rev + g.arcs() );
+	assert( g.first[1] >= 2 && g.rev[0] != 1 );
+	crossedRev[0] = 1;
+	crossedRev[1] = 0;
+	crossedRev[g.rev[0]] = g.rev[1];
+	crossedRev[g.rev[1]] = g.rev[0];
+	struct { size_t at; const void* value; size_t bytes; } corruptions[] = {
+		{ headerAt, sourceAsSink, sizeof(sourceAsSink) },
+		{ headerAt, missingSource, sizeof(missingSource) },
+		{ firstAt, badFirst, sizeof(badFirst) },
+		{ firstAt + (sizeof(int) * g.nodes()), badLast, sizeof(badLast) },
+		{ headAt, badHead, sizeof(badHead) },
+		{ revAt, selfRev, sizeof(selfRev) },
+		{ revAt, farRev, sizeof(farRev) },
+		{ revAt, unpairedRev, sizeof(unpairedRev) },
+		{ revAt, &crossedRev[0], sizeof(int) * crossedRev.size() } };
+	for (size_t i = 0; i < sizeof(corruptions) / sizeof(corruptions[0]); ++i)
+	{
+		assert( g.writeBinary( binaryGraph ) );
+		std::fstream file( binaryGraph, std::ios::in | std::ios::out | std::ios::binary );
+		file.seekp( corruptions[i].at );
+		file.write( static_cast<const char*>(corruptions[i].value), corruptions[i].bytes );
+		file.close();
+		FlowNetwork<int, int> corrupt;
+		assert( !corrupt.load( binaryGraph ) && corrupt.nodes() == 0 && corrupt.first == NULL );
+	}
+	remove( binaryGraph );
+	std::cerr << std::endl;
+}
+
+//! @brief Executes the unit tests for DIMACS max-flow input and solution output
+void runDimacsUnitTests()
+{
+	std::cerr << "DIMACS tests: " << std::endl;
+	const char* problem  = "test/graphs/dimacs1.max";
+	const char* solution = "test/graphs/temp.sol";
+	std::cerr << problem << "... ";
+
+	FlowNetwork<int64_t, int32_t> g;
+	assert( g.load( problem ) );
+	assert( g.nodes() == 6 && g.source == 2 && g.sink == 0 );
+
+	int64_t resultMaxFlow = Tools::fordFulkerson( g, g.source, g.sink );
+	if (resultMaxFlow != 23)
+	{
+		std::cerr << "Expected: 23, Received: " << resultMaxFlow << "\n";
+		assert( false );
+	}
+	assert( Tools::writeDimacsSolution( solution, g, resultMaxFlow ) );
+
+	// Flow must be conserved at every vertex but the source and sink, and the solution value must match the cut
+	std::ifstream input( solution );
+	std::vector<int> balance( g.nodes() + 1, 0 );
+	std::vector<char> side( g.nodes() + 1, '?' );
+	int value = -1;
+	std::string line;
+	while (getline( input, line ))
+	{
+		std::stringstream ss( line );
+		char descriptor;
+		ss >> descriptor;
+		if (descriptor == 's')
+			ss >> value;
+		else if (descriptor == 'f')
+		{
+			int from, to, flow;
+			ss >> from >> to >> flow;
+			balance[from] -= flow;
+			balance[to]   += flow;
+		}
+		else if (descriptor == 'n')
+		{
+			int id;
+			ss >> id >> side[id];
+		}
+	}
+	input.close();
+	remove( solution );
+
+	assert( value == 23 );
+	assert( balance[3] == -23 && balance[1] == 23 );
+	assert( balance[2] == 0 && balance[4] == 0 && balance[5] == 0 && balance[6] == 0 );
+	assert( side[3] == 's' && side[1] == 't' );
+
+	// A problem must have one problem line, and name one source and one other node as its sink
+	const char* badProblems[] = {
+		"p max 2 1\nn 1 s\nn 1 t\na 1 2 5\n",
+		"p max 2 1\nn 1 s\nn 2 s\nn 2 t\na 1 2 5\n",
+		"p max 2 1\nn 1 s\na 1 2 5\n",
+		"p max 2 1\nn 1 s\nn 2 t\na 1 2 5\np max 3 1\n" };
+	for (size_t i = 0; i < sizeof(badProblems) / sizeof(badProblems[0]); ++i)
+	{
+		std::ofstream output( solution );
+		output << badProblems[i];
+		output.close();
+		FlowNetwork<int64_t, int32_t> bad;
+		assert( !bad.fromDimacs( solution ) );
+	}
+	remove( solution );
+	std::cerr << std::endl;
+}
+
+void runWarmStartUnitTests()
+{
+	std::cerr << "Warm start tests: " << std::endl;
+	std::pair<std::string, int> maxFlowTestCases[] = {	
+				std::make_pair<std::string, int>( "test/graphs/testcase1.txt", 14 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase2.txt", 23 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase3.txt", 28 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase4.txt", 14 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase5.txt", 200 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase6.txt", 23 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase7.txt", 40 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase8.txt", 19 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase9.txt", 65 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase10.txt", 16 ) };
+
+	// Any greedy flow must still lead Ford-Fulkerson to the maximum flow
+	int searchLimits[] = { 0, 2, 64 };
+	int numTestCases = 10;
+	for (int i = 0; i < numTestCases; ++i) {
+		std::cerr << maxFlowTestCases[i].first << "... ";
+		for (int j = 0; j < 3; ++j)
+		{
+			FlowNetwork<int, int> g;
+			assert( g.fromFile( maxFlowTestCases[i].first.c_str() ) );
+			int initialFlow = Tools::greedyFlow( g, g.source, g.sink, searchLimits[j] );
+			int resultMaxFlow = Tools::fordFulkerson( g, g.source, g.sink, initialFlow );
+			if (initialFlow > maxFlowTestCases[i].second || resultMaxFlow != maxFlowTestCases[i].second)
+			{
+				std::cerr << "Expected: " << maxFlowTestCases[i].second << ", Received: " << resultMaxFlow
+					<< " from a greedy flow of " << initialFlow << "\n";
+				assert( false );
+			}
+		}
+		std::cerr << std::endl;
+	}
+}
+
+void runAnytimeUnitTests()
+{
+	std::cerr << "Time budget tests: " << std::endl;
+	std::pair<std::string, int> maxFlowTestCases[] = {	
+				std::make_pair<std::string, int>( "test/graphs/testcase1.txt", 14 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase2.txt", 23 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase3.txt", 28 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase4.txt", 14 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase5.txt", 200 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase6.txt", 23 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase7.txt", 40 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase8.txt", 19 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase9.txt", 65 ),
+				std::make_pair<std::string, int>( "test/graphs/testcase10.txt", 16 ) };
+
+	int numTestCases = 10;
+	for (int i = 0; i < numTestCases; ++i) {
+		std::cerr << maxFlowTestCases[i].first << "... ";
+
+		// A deadline that has already passed stops after the first augmentation, between the two bounds
+		FlowNetwork<int, int> g;
+		assert( g.fromFile( maxFlowTestCases[i].first.c_str() ) );
+		Tools::Deadline deadline = std::chrono::steady_clock::now();
+		int partialFlow = Tools::fordFulkerson( g, g.source, g.sink, 0, &deadline );
+		std::vector<bool> cut;
+		int64_t bound = Tools::boundingCut( g, g.source, g.sink, cut );
+		assert( partialFlow <= maxFlowTestCases[i].second && bound >= maxFlowTestCases[i].second );
+		assert( cut[g.source] && !cut[g.sink] && bound == Tools::cutCapacity( g, cut ) );
+
+		// The warm start gives up its searches too, keeping only the direct paths it saturates first
+		FlowNetwork<int, int> direct, late;
+		assert( direct.fromFile( maxFlowTestCases[i].first.c_str() ) && late.fromFile( maxFlowTestCases[i].first.c_str() ) );
+		assert( Tools::greedyFlow( late, late.source, late.sink, 64, &deadline )
+			== Tools::greedyFlow( direct, direct.source, direct.sink, 0 ) );
+		assert( std::equal( late.cap, late.cap + late.arcs(), direct.cap ) );
+
+		// Once the flow is maximal the bound meets it, and the cut is the minimum cut
+		int resultMaxFlow = Tools::fordFulkerson( g, g.source, g.sink, partialFlow );
+		bound = Tools::boundingCut( g, g.source, g.sink, cut );
+		std::vector<bool> minimumCut;
+		Tools::minCut( g, g.source, minimumCut );
+		if (resultMaxFlow != maxFlowTestCases[i].second || bound != resultMaxFlow || cut != minimumCut)
+		{
+			std::cerr << "Expected: " << maxFlowTestCases[i].second << ", Received: " << resultMaxFlow
+				<< " with a cut of " << bound << "\n";
+			assert( false );
+		}
+		std::cerr << std::endl;
+	}
+}
+
+void runLayoutUnitTests()
+{
+	std::cerr << "Node layout tests: " << std::endl;
+	const char* image = "test/pgm/2DGel-2.pgm";
+	std::cerr << image << "... ";
+
+	Pgm p;
+	assert( p.fromFile( image ) );
+	p.calculateThreshold();
+	int64_t pixels = static_cast<int64_t>(p.xMax) * p.yMax;
+
+	std::vector<bool> rasterCut;
+	Pgm::NodeLayout layouts[] = { Pgm::RASTER, Pgm::TILED, Pgm::MORTON };
+	for (int i = 0; i < 3; ++i)
+	{
+		p.layout = layouts[i];
+
+		// Every layout must number the pixels 0 to pixels - 1 without gaps or repeats
+		std::vector<bool> used( pixels, false );
+		for (int yPos = 0; yPos < p.yMax; ++yPos)
+			for (int xPos = 0; xPos < p.xMax; ++xPos)
+			{
+				int64_t id = p.nodeID( xPos, yPos );
+				assert( id >= 0 && id < pixels && !used[id] );
+				used[id] = true;
+			}
+
+		// and give the same cut, pixel for pixel, with or without a warm start
+		FlowNetwork<int16_t, int32_t> network;
+		p.addPaths( network );
+		p.addSuperNodes( network );
+		int64_t initialFlow = (layouts[i] == Pgm::MORTON) ? Tools::greedyFlow( network, network.source, network.sink, 64 ) : 0;
+		Tools::fordFulkerson( network, network.source, network.sink, initialFlow );
+		std::vector<bool> cut;
+		Tools::minCut( network, network.source, cut );
+		if (i == 0)
+			rasterCut = cut;
+		for (int yPos = 0; yPos < p.yMax; ++yPos)
+			for (int xPos = 0; xPos < p.xMax; ++xPos)
+				assert( cut[p.nodeID( xPos, yPos )] == rasterCut[(static_cast<int64_t>(p.xMax) * yPos) + xPos] );
+	}
+	std::cerr << std::endl;
+}
+
+void runWeightUnitTests()
+{
+	std::cerr << "Weight table tests: " << std::endl;
+	std::cerr << "linear, gaussian... ";
+
+	// The linear table matches the original capacities, thresholds included
+	WeightTable weights;
+	weights.build( WeightTable::LINEAR, 255, 100, 0 );
+	for (int a = 0; a <= 255; a += 5)
+	{
+		assert( weights.source( a ) == ((255 - a > 100) ? 255 - a : 0) );
+		assert( weights.sink( a ) == ((a > 100) ? a : 0) );
+		for (int b = 0; b <= 255; b += 5)
+			assert( weights.link( a, b ) == ((255 - abs( a - b ) > 100) ? 255 - abs( a - b ) : 0) );
+	}
+
+	// The gaussian boundary term is pixMax for equal neighbors and falls off with the difference
+	weights.build( WeightTable::GAUSSIAN, 65535, 0, 1000 );
+	assert( weights.link( 500, 500 ) == 65535 );
+	assert( weights.link( 0, 1000 ) == static_cast<int>( (65535 * exp( -0.5 )) + 0.5 ) );
+	for (int d = 1; d <= 65535; ++d)
+		assert( weights.link( 0, d ) <= weights.link( 0, d - 1 ) );
+	std::cerr << std::endl;
+
+	// A 16 bit raw copy of an image, scaled to the full range, segments the same as the 8 bit plain original
+	const char* image = "test/pgm/2DGel-2.pgm";
+	const char* wideImage = "test/pgm/temp16.pgm";
+	std::cerr << image << " (16 bit)... ";
+	Pgm narrow;
+	assert( narrow.fromFile( image ) );
+	std::ofstream output( wideImage, std::ios::binary );
+	output << "P5\n" << narrow.xMax << " " << narrow.yMax << "\n65535\n";
+	for (int yPos = 0; yPos < narrow.yMax; ++yPos)
+		for (int xPos = 0; xPos < narrow.xMax; ++xPos)
+			output.put( narrow.matrix[xPos][yPos] ).put( narrow.matrix[xPos][yPos] );
+	output.close();
+
+	Pgm wide;
+	assert( wide.fromFile( wideImage ) );
+	remove( wideImage );
+	assert( wide.pixMax == 65535 && wide.matrix[3][4] == narrow.matrix[3][4] * 257 );
+
+	std::vector<bool> cuts[2];
+	Pgm* images[] = { &narrow, &wide };
+	for (int i = 0; i < 2; ++i)
+	{
+		images[i]->calculateThreshold();
+		FlowNetwork<int32_t, int32_t> network;
+		images[i]->addPaths( network );
+		images[i]->addSuperNodes( network );
+		Tools::fordFulkerson( network, network.source, network.sink );
+		Tools::minCut( network, network.source, cuts[i] );
+	}
+	assert( cuts[0] == cuts[1] );
+	std::cerr << std::endl;
+}
+
+void runSegmenterUnitTests()
+{
+	std::cerr << "Segmenter tests: " << std::endl;
+	const char* images[] = { "test/pgm/2DGel-2.pgm", "test/pgm/feep.ascii.pgm", "test/pgm/2DGel-2.pgm" };
+	Segmenter segmenter;
+	iseg_segmenter* cSegmenter = iseg_create();
+	assert( cSegmenter );
+
+	// The same segmenter, reused for a smaller and then a larger image, must give the cut of a fresh network
+	for (int i = 0; i < 3; ++i)
+	{
+		std::cerr << images[i] << "... ";
+		Pgm p;
+		assert( p.fromFile( images[i] ) );
+		p.calculateThreshold();
+		FlowNetwork<int16_t, int32_t> network;
+		p.addPaths( network );
+		p.addSuperNodes( network );
+		int64_t resultMaxFlow = Tools::fordFulkerson( network, network.source, network.sink );
+		std::vector<bool> cut;
+		Tools::minCut( network, network.source, cut );
+
+		// Padded rows, as a caller's buffers often have
+		size_t stride = p.xMax + 3;
+		std::vector<unsigned char> pixels( stride * p.yMax, 0 );
+		for (int yPos = 0; yPos < p.yMax; ++yPos)
+			for (int xPos = 0; xPos < p.xMax; ++xPos)
+				pixels[(stride * yPos) + xPos] = p.matrix[xPos][yPos];
+		std::vector<unsigned char> mask( stride * p.yMax, 7 ), cMask( stride * p.yMax, 7 );
+		assert( segmenter.segment( &pixels[0], p.xMax, p.yMax, stride, 8, &mask[0], stride ) );
+		assert( iseg_segment( cSegmenter, &pixels[0], p.xMax, p.yMax, stride, 8, &cMask[0], stride ) == 0 );
+		assert( segmenter.maxFlow == resultMaxFlow && segmenter.cutCapacity == resultMaxFlow );
+		for (int yPos = 0; yPos < p.yMax; ++yPos)
+			for (int xPos = 0; xPos < p.xMax; ++xPos)
+			{
+				size_t at = (stride * yPos) + xPos;
+				assert( mask[at] == (cut[p.nodeID( xPos, yPos )] ? 1 : 0) && cMask[at] == mask[at] );
+			}
+		assert( mask[stride - 1] == 7 );
+		std::cerr << std::endl;
+	}
+
+	unsigned char pixel = 0;
+	assert( iseg_segment( cSegmenter, &pixel, 1, 1, 1, 17, &pixel, 1 ) == -1 );
+	iseg_destroy( cSegmenter );
+}
+
+void runComponentUnitTests()
+{
+	std::cerr << "Component tests: " << std::endl;
+	const char* image = "test/pgm/temp-noise.pgm";
+	const char* cuts[] = { "test/pgm/temp-whole.pgm", "test/pgm/temp-parts.pgm" };
+	std::cerr << "noise... ";
+
+	// Speckled noise over two flat regions breaks the pixels into many components, single pixels among them
+	std::ofstream output( image );
+	output << "P2\n64 48\n255\n";
+	unsigned int seed = 12345;
+	for (int yPos = 0; yPos < 48; ++yPos)
+	{
+		for (int xPos = 0; xPos < 64; ++xPos)
+		{
+			seed = (seed * 1103515245) + 12345;
+			int value = (xPos < 32) ? 40 : 200;
+			if ((seed >> 16) % 4 == 0)
+				value = (seed >> 8) % 256;
+			output << value << " ";
+		}
+		output << "\n";
+	}
+	output.close();
+
+	Pgm p;
+	assert( p.fromFile( image ) );
+	p.calculateThreshold();
+	std::vector<int32_t> start, pixels;
+	int components = p.findComponents( start, pixels );
+	assert( components > 1 && start[components] == 64 * 48 );
+	bool single = false;
+	for (int i = 0; i < components; ++i)
+		single = single || (start[i + 1] - start[i] == 1);
+	assert( single );
+
+	// The cut is the same whether the image is solved whole or component by component on several threads
+	Tools::segmentOptions options;
+	options.components = false;
+	Tools::segmentImage( image, cuts[0], options );
+	options.components = true;
+	options.threads = 3;
+	Tools::segmentImage( image, cuts[1], options );
+
+	std::ifstream whole( cuts[0] ), parts( cuts[1] );
+	std::stringstream wholeText, partsText;
+	wholeText << whole.rdbuf();
+	partsText << parts.rdbuf();
+	assert( wholeText.str() == partsText.str() );
+	remove( image );
+	remove( cuts[0] );
+	remove( cuts[1] );
+	std::cerr << std::endl;
+}
+
+//! @brief Stores a result under a key shared with other writers, its foreground set only if its flow is odd
+struct sharedCacheWriter
+{
+	ResultCache* cache;
+	int64_t flow;
+
+	void operator()() const
+	{
+		std::vector<bool> mask( 64 * 64, flow % 2 == 1 );
+		assert( cache->store( "shared", 64, 64, mask, flow ) );
+	}
+};
+
+void runCacheUnitTests()
+{
+	std::cerr << "Result cache tests: " << std::endl;
+	const char* directory = "test/cache-temp";
+	std::cerr << "hash... ";
+	ContentHash first, second, third;
+	first.add( "segmentation", 12 );
+	second.add( "segmentation", 12 );
+	third.add( "segmentatioN", 12 );
+	assert( first.hex() == second.hex() && first.hex() != third.hex() && first.hex().size() == 32 );
+
+	std::cerr << "store, find, evict... ";
+	ResultCache cache;
+	assert( cache.open( directory, 2 * (sizeof(ResultCache::header) + 2) ) );
+	bool pattern[] = { true, false, true, false, false, true, true, true, false };
+	std::vector<bool> mask( pattern, pattern + 9 ), found;
+	int64_t flow = 0;
+	assert( cache.store( "first", 3, 3, mask, 17 ) );
+	assert( cache.find( "first", 3, 3, found, flow ) && found == mask && flow == 17 );
+	assert( !cache.find( "first", 9, 1, found, flow ) );
+	assert( !cache.find( "missing", 3, 3, found, flow ) );
+
+	// Timestamps are only as fine as the clock tick, so the steps are spaced out to keep their order
+	std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+	assert( cache.store( "second", 3, 3, mask, 18 ) );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+	assert( cache.find( "first", 3, 3, found, flow ) );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+	assert( cache.store( "third", 3, 3, mask, 19 ) );
+	assert( cache.find( "first", 3, 3, found, flow ) && flow == 17 );
+	assert( !cache.find( "second", 3, 3, found, flow ) );
+	assert( cache.find( "third", 3, 3, found, flow ) && flow == 19 );
+	remove( "test/cache-temp/first.cut" );
+	remove( "test/cache-temp/third.cut" );
+
+	// Threads storing the same key at once each write a file of their own, so the result is one of theirs whole
+	std::cerr << "concurrent stores... ";
+	ResultCache shared;
+	assert( shared.open( directory, 1 << 20 ) );
+	std::vector<std::thread> writers;
+	for (int64_t i = 0; i < 8; ++i)
+	{
+		sharedCacheWriter writer = { &shared, i };
+		writers.push_back( std::thread( writer ) );
+	}
+	for (size_t i = 0; i < writers.size(); ++i)
+		writers[i].join();
+	assert( shared.find( "shared", 64, 64, found, flow ) && flow >= 0 && flow < 8 );
+	assert( found == std::vector<bool>( 64 * 64, flow % 2 == 1 ) );
+	remove( "test/cache-temp/shared.cut" );
+	DIR* leftovers = opendir( directory );
+	for (struct dirent* item = readdir( leftovers ); item; item = readdir( leftovers ))
+		assert( strncmp( item->d_name, ".tmp-", 5 ) != 0 );
+	closedir( leftovers );
+
+	// A second run is answered from the cache: emptying the cached foreground empties the cut written
+	std::cerr << "segmentation... ";
+	const char* image = "test/pgm/2DGel-2.pgm";
+	const char* cuts[] = { "test/pgm/temp-solved.pgm", "test/pgm/temp-cached.pgm" };
+	Tools::segmentOptions options;
+	options.cacheDirectory = directory;
+	Tools::segmentImage( image, cuts[0], options );
+
+	std::string entry;
+	DIR* listing = opendir( directory );
+	for (struct dirent* item = readdir( listing ); item; item = readdir( listing ))
+		if (item->d_name[0] != '.')
+			entry = std::string( directory ) + "/" + item->d_name;
+	closedir( listing );
+	assert( !entry.empty() );
+
+	Pgm p;
+	assert( p.fromFile( image ) && cache.open( directory, options.cacheBytes ) );
+	std::vector<bool> none( static_cast<size_t>(p.xMax) * p.yMax, false );
+	std::string key = entry.substr( strlen( directory ) + 1, 32 );
+	assert( cache.find( key, p.xMax, p.yMax, found, flow ) && flow > 0 );
+	assert( cache.store( key, p.xMax, p.yMax, none, flow ) );
+	Tools::segmentImage( image, cuts[1], options );
+
+	Pgm solved, cached;
+	assert( solved.fromFile( cuts[0] ) && cached.fromFile( cuts[1] ) );
+	bool different = false;
+	for (int xPos = 0; xPos < p.xMax; ++xPos)
+	{
+		for (int yPos = 0; yPos < p.yMax; ++yPos)
+		{
+			assert( cached.matrix[xPos][yPos] == cached.pixMax );
+			different = different || (solved.matrix[xPos][yPos] != solved.pixMax);
+		}
+	}
+	assert( different );
+
+	remove( entry.c_str() );
+	rmdir( directory );
+	remove( cuts[0] );
+	remove( cuts[1] );
+	std::cerr << std::endl;
+}
+
+void runStreamUnitTests()
+{
+	std::cerr << "Stream tests: " << std::endl;
+	const char* images[] = { "test/pgm/2DGel-2.pgm", "test/pgm/feep.ascii.pgm", "test/pgm/temp-raw.pgm",
+		"test/pgm/2DGel-2.pgm" };
+	const char* cut = "test/pgm/temp-stream.pgm";
+	std::cerr << "plain and raw... ";
+
+	// A raw image among the plain ones
+	std::ofstream raw( images[2], std::ios::binary );
+	raw << "P5\n16 12\n255\n";
+	for (int i = 0; i < 16 * 12; ++i)
+		raw.put( static_cast<char>(((i % 16) < 8) ? 30 + (i % 7) : 220 - (i % 5)) );
+	raw.close();
+
+	// The cuts come out in order and match those written one file at a time
+	std::stringstream input, expected, output;
+	for (int i = 0; i < 4; ++i)
+	{
+		std::ifstream image( images[i], std::ios::binary );
+		input << image.rdbuf() << "\n";
+		Tools::segmentImage( images[i], cut );
+		std::ifstream result( cut );
+		expected << result.rdbuf();
+	}
+	assert( Tools::segmentStream( input, output, Tools::segmentOptions(), 1 ) );
+	assert( output.str() == expected.str() );
+
+	std::cerr << "truncated... ";
+	std::stringstream truncated( "P2\n2 2\n255\n1 2 3" ), nothing;
+	assert( !Tools::segmentStream( truncated, nothing ) );
+	assert( nothing.str().empty() );
+
+	remove( images[2] );
+	remove( cut );
+	std::cerr << std::endl;
+}
+
+void runBandUnitTests()
+{
+	std::cerr << "Band build tests: " << std::endl;
+	const char* image = "test/pgm/temp-bands.pgm";
+	std::cerr << "raster, tiled... ";
+
+	// Large enough to be split into several bands
+	std::ofstream output( image );
+	output << "P2\n600 400\n255\n";
+	unsigned int seed = 777;
+	for (int i = 0; i < 600 * 400; ++i)
+	{
+		seed = (seed * 1103515245) + 12345;
+		output << ((seed >> 16) % 256) << " ";
+	}
+	output.close();
+
+	Pgm p;
+	assert( p.fromFile( image ) );
+	p.calculateThreshold();
+
+	// Every band count fills the network identically, reverse arcs included
+	Pgm::NodeLayout layouts[] = { Pgm::RASTER, Pgm::TILED };
+	for (int i = 0; i < 2; ++i)
+	{
+		p.layout = layouts[i];
+		FlowNetwork<int16_t, int32_t> one, three;
+		p.threads = 1;
+		p.addPaths( one );
+		p.addSuperNodes( one );
+		p.threads = 3;
+		p.addPaths( three );
+		p.addSuperNodes( three );
+
+		assert( one.nodes() == three.nodes() && one.arcs() == three.arcs() );
+		assert( one.source == three.source && one.sink == three.sink );
+		for (int32_t node = 0; node <= one.nodes(); ++node)
+			assert( one.first[node] == three.first[node] );
+		for (int32_t arc = 0; arc < one.arcs(); ++arc)
+		{
+			assert( one.head[arc] == three.head[arc] && one.rev[arc] == three.rev[arc] );
+			assert( one.base[arc] == three.base[arc] && one.cap[arc] == three.cap[arc] && one.cap[arc] == one.base[arc] );
+			assert( three.rev[three.rev[arc]] == arc );
+		}
+	}
+	remove( image );
+	std::cerr << std::endl;
+}
+
+void runCutTreeUnitTests()
+{
+	std::cerr << "Cut tree tests: " << std::endl;
+	const char* problem = "test/graphs/temp-tree.max";
+	std::cerr << "all pairs... ";
+
+	// A random network with every arc matched by one of the same capacity back
+	const int vertices = 14;
+	std::stringstream arcs;
+	int count = 0;
+	unsigned int seed = 4242;
+	for (int u = 1; u <= vertices; ++u)
+	{
+		for (int v = u + 1; v <= vertices; ++v)
+		{
+			seed = (seed * 1103515245) + 12345;
+			if ((seed >> 16) % 3 != 0)
+				continue;
+			int capacity = 1 + ((seed >> 8) % 20);
+			arcs << "a " << u << " " << v << " " << capacity << "\na " << v << " " << u << " " << capacity << "\n";
+			count += 2;
+		}
+	}
+	std::ofstream output( problem );
+	output << "p max " << vertices << " " << count << "\nn 1 s\nn " << vertices << " t\n" << arcs.str();
+	output.close();
+
+	FlowNetwork<int64_t, int32_t> g;
+	assert( g.load( problem ) && Tools::symmetricCapacities( g ) );
+	Tools::CutTree<int64_t, int32_t> tree;
+	Tools::cutTree( g, tree );
+
+	// Every pair's tree lookup matches a max flow of its own
+	for (int32_t u = 0; u < vertices; ++u)
+	{
+		for (int32_t v = 0; v < vertices; ++v)
+		{
+			if (u == v)
+				continue;
+			g.reset();
+			assert( tree.minCut( u, v ) == Tools::fordFulkerson( g, u, v ) );
+		}
+	}
+
+	std::cerr << "asymmetric... ";
+	FlowNetwork<int64_t, int32_t> directed;
+	assert( directed.load( "test/graphs/dimacs1.max" ) && !Tools::symmetricCapacities( directed ) );
+	remove( problem );
+	std::cerr << std::endl;
+}
+
+void runMultiTargetUnitTests()
+{
+	std::cerr << "Multi-target search tests: " << std::endl;
+	for (int testCase = 1; testCase <= 10; ++testCase)
+	{
+		std::stringstream file;
+		file << "test/graphs/testcase" << testCase << ".txt";
+		std::cerr << file.str() << "... ";
+
+		FlowNetwork<int64_t, int32_t> g;
+		assert( g.load( file.str().c_str() ) );
+
+		// One search to every vertex finds the same path and capacity as a search for each vertex alone
+		for (int32_t start = 0; start < g.nodes(); ++start)
+		{
+			Tools::SearchTree<int64_t, int32_t> tree;
+			assert( Tools::searchTree( g, start, std::vector<int32_t>(), tree ) );
+			for (int32_t end = 0; end < g.nodes(); ++end)
+			{
+				if (end == start)
+					continue;
+				std::pair< std::vector<int32_t>, int64_t > single = Tools::breadthFirstSearch( g, start, end );
+				assert( tree.reached( end ) == !single.first.empty() );
+				if (!tree.reached( end ))
+					continue;
+
+				std::vector<int32_t> path;
+				tree.path( end, path );
+				assert( path == single.first && tree.bottleneck[end] == single.second );
+				assert( tree.distance[end] + 1 == static_cast<int32_t>(path.size()) );
+			}
+
+			// and a search for a few vertices stops with those reached
+			std::vector<int32_t> ends( 1, g.nodes() - 1 );
+			ends.push_back( start );
+			Tools::SearchTree<int64_t, int32_t> partial;
+			Tools::searchTree( g, start, ends, partial );
+			assert( partial.reached( start ) && partial.reached( ends[0] ) == tree.reached( ends[0] ) );
+			if (partial.reached( ends[0] ))
+				assert( partial.distance[ends[0]] == tree.distance[ends[0]] );
+		}
+	}
+	std::cerr << std::endl;
+}
+
+void runCheckpointUnitTests()
+{
+	std::cerr << "Checkpoint tests: " << std::endl;
+	const char* image = "test/pgm/coins.ascii.pgm";
+	const char* checkpointFile = "test/graphs/temp.ckp";
+	std::cerr << image << "... ";
+
+	Pgm p;
+	assert( p.fromFile( image ) );
+	p.calculateThreshold();
+	FlowNetwork<int16_t, int32_t> solved;
+	p.addPaths( solved );
+	p.addSuperNodes( solved );
+	int64_t expected = Tools::fordFulkerson( solved, solved.source, solved.sink );
+	std::vector<bool> expectedCut;
+	Tools::minCut( solved, solved.source, expectedCut );
+
+	// Interrupt a solve after a run of augmentations, each of which asks for a snapshot
+	int64_t partialFlow = 0;
+	{
+		FlowNetwork<int16_t, int32_t> g;
+		p.addPaths( g );
+		p.addSuperNodes( g );
+		Tools::FlowCheckpoint<int16_t, int32_t> checkpoint;
+		assert( checkpoint.create( checkpointFile, g, partialFlow, 0 ) );
+		Tools::FlowWorkspace<int32_t> workspace;
+		for (int i = 0; i < 200; ++i)
+		{
+			Tools::Deadline deadline = std::chrono::steady_clock::now();
+			partialFlow = Tools::fordFulkerson( g, g.source, g.sink, partialFlow, &deadline, workspace, &checkpoint );
+		}
+		assert( partialFlow > 0 && partialFlow < expected );
+	}
+
+	// A fresh network resumes from a snapshot no later than the interruption, and is solved to the same flow and cut
+	{
+		FlowNetwork<int16_t, int32_t> g;
+		p.addPaths( g );
+		p.addSuperNodes( g );
+		Tools::FlowCheckpoint<int16_t, int32_t> checkpoint;
+		int64_t resumedFlow = -1;
+		assert( checkpoint.resume( checkpointFile, g, resumedFlow, 0 ) );
+		assert( resumedFlow >= 0 && resumedFlow <= partialFlow );
+		Tools::FlowWorkspace<int32_t> workspace;
+		int64_t maxFlow = Tools::fordFulkerson( g, g.source, g.sink, resumedFlow, NULL, workspace, &checkpoint );
+		assert( checkpoint.finish( g, maxFlow ) );
+		std::vector<bool> cut;
+		Tools::minCut( g, g.source, cut );
+		assert( maxFlow == expected && cut == expectedCut );
+	}
+
+	// After finishing, the file holds the maximum flow
+	{
+		FlowNetwork<int16_t, int32_t> g;
+		p.addPaths( g );
+		p.addSuperNodes( g );
+		Tools::FlowCheckpoint<int16_t, int32_t> checkpoint;
+		int64_t resumedFlow = -1;
+		assert( checkpoint.resume( checkpointFile, g, resumedFlow, 0 ) );
+		assert( resumedFlow == expected && Tools::fordFulkerson( g, g.source, g.sink, resumedFlow ) == expected );
+	}
+
+	// and belongs to no other network
+	{
+		Pgm other;
+		assert( other.fromFile( "test/pgm/feep.ascii.pgm" ) );
+		other.calculateThreshold();
+		FlowNetwork<int16_t, int32_t> g;
+		other.addPaths( g );
+		other.addSuperNodes( g );
+		Tools::FlowCheckpoint<int16_t, int32_t> checkpoint;
+		int64_t resumedFlow = 0;
+		assert( !checkpoint.resume( checkpointFile, g, resumedFlow, 0 ) );
+		assert( resumedFlow == 0 && std::equal( g.cap, g.cap + g.arcs(), g.base ) );
+	}
+
+	// A file cut short is refused, and leaves the network as it was
+	assert( truncate( checkpointFile, CheckpointFile::DATA_AT + 100 ) == 0 );
+	{
+		FlowNetwork<int16_t, int32_t> g;
+		p.addPaths( g );
+		p.addSuperNodes( g );
+		Tools::FlowCheckpoint<int16_t, int32_t> checkpoint;
+		int64_t resumedFlow = 0;
+		assert( !checkpoint.resume( checkpointFile, g, resumedFlow, 0 ) );
+		assert( resumedFlow == 0 && std::equal( g.cap, g.cap + g.arcs(), g.base ) );
+	}
+	unlink( checkpointFile );
+	std::cerr << std::endl;
+}
+
+void runFlatRegionUnitTests()
+{
+	std::cerr << "Flat region tests: " << std::endl;
+	const char* images[] = { "test/pgm/FEEP.pgm", "test/pgm/dla.ascii.pgm", "test/pgm/coins.ascii.pgm" };
+	bool flat[] = { true, true, false };
+	for (int i = 0; i < 3; ++i)
+	{
+		std::cerr << images[i] << "... ";
+		Pgm p;
+		assert( p.fromFile( images[i] ) );
+		p.calculateThreshold();
+		int64_t pixels = static_cast<int64_t>(p.xMax) * p.yMax;
+
+		FlowNetwork<int32_t, int32_t> pixelNetwork;
+		p.addPaths( pixelNetwork );
+		p.addSuperNodes( pixelNetwork );
+		int64_t exact = Tools::fordFulkerson( pixelNetwork, pixelNetwork.source, pixelNetwork.sink );
+
+		flatRegions regions;
+		int32_t count = p.findRegions( 0, regions );
+		for (int yPos = 0; yPos < p.yMax; ++yPos)
+			for (int xPos = 0; xPos < p.xMax - 1; ++xPos)
+				if (regions.label[(p.xMax * yPos) + xPos] == regions.label[(p.xMax * yPos) + xPos + 1])
+					assert( p.matrix[xPos][yPos] == p.matrix[xPos + 1][yPos] );
+		if (flat[i])
+			assert( count * 10 < pixels );
+
+		// The cut of the region network, spread over the pixels, is a cut of the pixel network of the same capacity.
+		// Keeping every region whole can only raise the minimum, and leaves it alone on images made of flat regions.
+		FlowNetwork<int64_t, int32_t> regionNetwork;
+		p.addRegions( regionNetwork, regions );
+		assert( regionNetwork.nodes() == count + 2 );
+		int64_t merged = Tools::fordFulkerson( regionNetwork, regionNetwork.source, regionNetwork.sink );
+		std::vector<bool> regionSide, cut( pixels + 2, false );
+		Tools::minCut( regionNetwork, regionNetwork.source, regionSide );
+		for (int64_t pixel = 0; pixel < pixels; ++pixel)
+			cut[pixel] = regionSide[regions.label[pixel]];
+		cut[pixelNetwork.source] = true;
+		assert( Tools::cutCapacity( pixelNetwork, cut ) == merged && merged >= exact );
+		if (flat[i])
+			assert( merged == exact );
+
+		// With a tolerance, the pixels of a region are within twice the tolerance of each other
+		flatRegions wider;
+		p.findRegions( 16, wider );
+		for (int yPos = 0; yPos < p.yMax; ++yPos)
+			for (int xPos = 0; xPos < p.xMax - 1; ++xPos)
+				if (wider.label[(p.xMax * yPos) + xPos] == wider.label[(p.xMax * yPos) + xPos + 1])
+					assert( std::abs( p.matrix[xPos][yPos] - p.matrix[xPos + 1][yPos] ) <= 32 );
+	}
+	std::cerr << std::endl;
+}
+
+void runTiledUnitTests()
+{
+	std::cerr << "Out-of-core tests: " << std::endl;
+	std::cerr << "TileStore, SpillQueue... ";
+
+	// A store with room for a few rows evicts tiles, and what was written to them comes back from the scratch file
+	TileStore store;
+	int width = 100, height = 60;
+	assert( store.create( width, height, 4 * sizeof(tilePixel) * width, "/tmp" ) );
+	for (int yPos = 0; yPos < height; ++yPos)
+		for (int xPos = 0; xPos < width; ++xPos)
+			store.at( xPos, yPos ).value = (xPos * 7) + yPos;
+	for (int yPos = height - 1; yPos >= 0; --yPos)
+		for (int xPos = 0; xPos < width; ++xPos)
+			assert( store.at( xPos, yPos ).value == (xPos * 7) + yPos );
+	assert( store.maxResident < static_cast<size_t>(store.tiles) && store.tileLoads > static_cast<size_t>(store.tiles) );
+	assert( !store.failed );
+
+	// A queue that overflows its memory limit spills to disk and still hands entries back in order
+	SpillQueue queue( 1024 );
+	int64_t pushed = 0, popped = 0, value;
+	for (; pushed < 10000; ++pushed)
+		queue.push( pushed );
+	for (; popped < 3000; ++popped)
+		assert( queue.pop( value ) && value == popped );
+	for (; pushed < 15000; ++pushed)
+		queue.push( pushed );
+	while (queue.pop( value ))
+		assert( value == popped++ );
+	assert( popped == pushed && !queue.failed() );
+	std::cerr << std::endl;
+
+	// Segmenting with a budget of a few rows gives the same flow and cut as segmenting in memory
+	const char* image = "test/pgm/2DGel-2.pgm";
+	std::cerr << image << "... ";
+	Pgm p;
+	assert( p.fromFile( image ) );
+	p.calculateThreshold();
+	FlowNetwork<int16_t, int32_t> network;
+	p.addPaths( network );
+	p.addSuperNodes( network );
+	int64_t expected = Tools::fordFulkerson( network, network.source, network.sink );
+
+	const char* inMemory = "test/pgm/temp-memory.pgm";
+	const char* tiled = "test/pgm/temp-tiled.pgm";
+	assert( Tools::segmentImage( image, inMemory ) );
+	int64_t maxFlow = -1;
+	assert( Tools::segmentImageTiled( image, tiled, 8 * sizeof(tilePixel) * p.xMax, "/tmp", Tools::segmentOptions(),
+		&maxFlow ) );
+	assert( maxFlow == expected );
+	std::ifstream a( inMemory ), b( tiled );
+	std::stringstream aText, bText;
+	aText << a.rdbuf();
+	bText << b.rdbuf();
+	assert( aText.str().size() > 0 && aText.str() == bText.str() );
+	unlink( inMemory );
+	unlink( tiled );
+
+	// Both paths fail on an image that cannot be read or a cut that cannot be written
+	std::cerr << "missing files... ";
+	const char* noDirectory = "test/pgm/missing-directory/temp.pgm";
+	assert( !Tools::segmentImage( "test/pgm/missing.pgm", inMemory ) );
+	assert( !Tools::segmentImage( image, noDirectory ) );
+	assert( !Tools::segmentImageTiled( image, noDirectory, 1 << 20, "/tmp", Tools::segmentOptions() ) );
+	std::cerr << std::endl;
+}
+
 int main() {
 
 	runBfsTimingMetrics();
@@ -353,6 +1335,22 @@ int main() {
 
 	runBfsUnitTests();
 	runFfUnitTests();
+	runNetworkUnitTests();
+	runDimacsUnitTests();
+	runLayoutUnitTests();
+	runWarmStartUnitTests();
+	runAnytimeUnitTests();
+	runSegmenterUnitTests();
+	runWeightUnitTests();
+	runComponentUnitTests();
+	runCacheUnitTests();
+	runStreamUnitTests();
+	runBandUnitTests();
+	runCutTreeUnitTests();
+	runMultiTargetUnitTests();
+	runCheckpointUnitTests();
+	runFlatRegionUnitTests();
+	runTiledUnitTests();
 
 	return 0;
 }